@@ -0,0 +1,85 @@
+"""
+Decode the FAULT_RECORD flash page.
+
+Read the page with an st-link and decode it:
+
+    st-flash read fault.bin 0x08007800 1024
+    python fault_decode.py fault.bin
+
+Layout (fault_record.c): 32 bit little endian words
+magic, reason, time, looptime (float), liberror, rxmode, failsafe,
+pc, lr, xpsr, ring_next, ring[16], checksum.
+A ring entry is the uS time (24 bit) << 8 | loop stage, in the order
+they were written starting at ring_next.
+"""
+import argparse
+import struct
+import sys
+
+MAGIC = 0x46524543
+RING = 16
+WORDS = 11 + RING + 1
+
+REASONS = {
+    5: "hard fault",
+    6: "loop time over 20 ms",
+    7: "i2c error at startup",
+    8: "i2c errors in the main loop",
+    9: "rgb led dma still running at the dshot update",
+}
+
+STAGES = ["loop start", "sixaxis_read", "control", "imu_calc", "battery / leds", "checkrx", "loop wait"]
+
+RXMODES = {0: "bind", 1: "normal"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="binary dump of the flash page")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as f:
+        data = f.read(WORDS * 4)
+    if len(data) < WORDS * 4:
+        sys.exit("dump too short")
+
+    words = struct.unpack("<%dI" % WORDS, data)
+    if words[0] != MAGIC:
+        sys.exit("no fault record (page erased or never written)")
+    if sum(words[:-1]) & 0xFFFFFFFF != words[-1]:
+        print("warning: checksum does not match, the write may have been cut short")
+
+    reason, time = words[1], words[2]
+    looptime = struct.unpack("<f", struct.pack("<I", words[3]))[0]
+    liberror, rxmode, failsafe = [struct.unpack("<i", struct.pack("<I", w))[0] for w in words[4:7]]
+    pc, lr, xpsr, ring_next = words[7:11]
+    ring = words[11:11 + RING]
+
+    print("reason      %d, %s" % (reason, REASONS.get(reason, "unknown")))
+    print("time        %.3f s after boot" % (time * 1e-6))
+    print("looptime    %.3f ms" % (looptime * 1e3))
+    print("liberror    %d" % liberror)
+    print("rxmode      %s" % RXMODES.get(rxmode, hex(rxmode)))
+    print("failsafe    %d" % failsafe)
+    if reason == 5:
+        print("pc          0x%08x  ( arm-none-eabi-addr2line -e silverware.elf 0x%08x )" % (pc, pc))
+        print("lr          0x%08x" % lr)
+        print("xpsr        0x%08x  exception %d" % (xpsr, xpsr & 0x3F))
+
+    print("")
+    print("last loop stages, uS from the first one shown")
+    entries = [ring[(ring_next + i) % RING] for i in range(RING)]
+    entries = [e for e in entries if e]
+    if not entries:
+        return
+    start = entries[0] >> 8
+    last = start
+    for e in entries:
+        t, stage = e >> 8, e & 0xFF
+        name = STAGES[stage] if stage < len(STAGES) else "stage %d" % stage
+        print("%8d  %+7d  %s" % ((t - start) & 0xFFFFFF, (t - last) & 0xFFFFFF, name))
+        last = t
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,162 @@
+"""
+Gyro noise spectrum from a GYRO_CAPTURE dump.
+
+Reads the binary capture frames sent on the serial tx (from a serial port
+or a file saved with any terminal program) and plots the power spectral
+density of each captured axis.
+
+    python gyro_psd.py COM5
+    python gyro_psd.py capture.bin --save noise.png
+
+Frame format (drv_serial.c): 0xA5, type, length, payload, xor checksum.
+Type 2 is the capture header, type 3 the data frames.
+"""
+import argparse
+import struct
+import sys
+
+import numpy as np
+import matplotlib.pyplot as plt
+
+SYNC = 0xA5
+FRAME_HEADER = 2
+FRAME_DATA = 3
+
+GYRO_SCALE = 0.061035156    # deg/s per sensor unit
+MOTOR_SCALE = 1.0 / 10000.0
+
+
+def frames(data):
+    """Yield (type, payload) for every frame with a valid checksum."""
+    i = 0
+    while i + 4 <= len(data):
+        if data[i] != SYNC:
+            i += 1
+            continue
+        ftype, length = data[i + 1], data[i + 2]
+        end = i + 3 + length
+        if end >= len(data):
+            break
+        payload = data[i + 3:end]
+        checksum = ftype ^ length
+        for b in payload:
+            checksum ^= b
+        if checksum != data[end]:
+            i += 1
+            continue
+        yield ftype, payload
+        i = end + 1
+
+
+def channels(axes):
+    names = [name for bit, name in ((1, "roll"), (2, "pitch"), (4, "yaw")) if axes & bit]
+    if axes & 8:
+        names += ["motor%d" % m for m in range(4)]
+    return names
+
+
+def captures(data):
+    """Yield (looptime_us, {channel: samples}) for every complete capture."""
+    header = None
+    values = None
+    for ftype, payload in frames(data):
+        if ftype == FRAME_HEADER and len(payload) == 6:
+            version, axes, looptime, samples = struct.unpack("<BBHH", payload)
+            names = channels(axes)
+            header = (looptime, names, samples)
+            values = np.zeros(samples * len(names), dtype=np.int16)
+            received = 0
+        elif ftype == FRAME_DATA and header is not None:
+            index = struct.unpack("<H", payload[:2])[0]
+            chunk = np.frombuffer(bytes(payload[2:]), dtype="<i2")
+            values[index:index + len(chunk)] = chunk
+            received += len(chunk)
+            if received >= len(values):
+                looptime, names, samples = header
+                rows = values.reshape(samples, len(names))
+                out = {}
+                for n, name in enumerate(names):
+                    scale = MOTOR_SCALE if name.startswith("motor") else GYRO_SCALE
+                    out[name] = rows[:, n] * scale
+                yield looptime, out
+                header = None
+
+
+def read_serial(port, baud, timeout):
+    import serial
+    with serial.Serial(port, baud, timeout=timeout) as s:
+        print("waiting for a capture on %s ..." % port)
+        data = bytearray()
+        while True:
+            chunk = s.read(4096)
+            if not chunk and data:
+                return bytes(data)
+            data += chunk
+
+
+def psd(x, fs, segment):
+    """Welch PSD with a hann window and 50% overlap."""
+    x = x - np.mean(x)
+    segment = min(segment, len(x))
+    step = segment // 2
+    window = np.hanning(segment)
+    scale = fs * np.sum(window ** 2)
+    spectra = []
+    for start in range(0, len(x) - segment + 1, step):
+        f = np.fft.rfft(x[start:start + segment] * window)
+        spectra.append(np.abs(f) ** 2 / scale)
+    p = np.mean(spectra, axis=0)
+    p[1:-1] *= 2
+    return np.fft.rfftfreq(segment, 1.0 / fs), p
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="serial port or capture file")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=2.0, help="serial idle time that ends the capture")
+    parser.add_argument("--segment", type=int, default=128, help="welch segment length, samples")
+    parser.add_argument("--save", help="write the plot to a file instead of showing it")
+    args = parser.parse_args()
+
+    try:
+        with open(args.source, "rb") as f:
+            data = f.read()
+    except (IOError, OSError):
+        data = read_serial(args.source, args.baud, args.timeout)
+
+    result = list(captures(bytearray(data)))
+    if not result:
+        sys.exit("no complete capture found")
+
+    looptime, capture = result[-1]
+    fs = 1e6 / looptime
+    gyro = [name for name in capture if not name.startswith("motor")]
+    motors = [name for name in capture if name.startswith("motor")]
+
+    rows = 2 if motors else 1
+    fig, axes = plt.subplots(rows, 1, sharex=True, squeeze=False)
+    for name in gyro:
+        f, p = psd(capture[name], fs, args.segment)
+        axes[0][0].semilogy(f, p, label=name)
+    axes[0][0].set_ylabel("(deg/s)^2 / Hz")
+    for name in motors:
+        f, p = psd(capture[name], fs, args.segment)
+        axes[-1][0].semilogy(f, p, label=name)
+    if motors:
+        axes[-1][0].set_ylabel("motor^2 / Hz")
+    for ax in axes[:, 0]:
+        ax.grid(True, which="both")
+        ax.legend()
+    axes[-1][0].set_xlabel("Hz")
+    n = len(next(iter(capture.values())))
+    fig.suptitle("gyro noise, %d samples at %.0f Hz" % (n, fs))
+
+    if args.save:
+        fig.savefig(args.save)
+    else:
+        plt.show()
+
+
+if __name__ == "__main__":
+    main()
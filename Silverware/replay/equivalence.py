@@ -0,0 +1,145 @@
+"""
+Equivalence check of two source versions over a trace.
+
+Both versions are built as replay binaries for every config variant and run
+over the same trace, the outputs ( pidoutput, motors, filtered gyro ) of the
+new build are compared with the baseline build and the check fails if any
+value differs by more than the tolerance. For refactors that must not change
+the flight behaviour, like the matrix mixer or the fixed kalman gain.
+
+    python equivalence.py --base b90d09d^ --new b90d09d
+    python equivalence.py --base HEAD trace.csv
+    python equivalence.py --base ce038f5^ --new ce038f5 --tolerance 1e-6 trace.csv
+
+--base and --new are git revisions, --new defaults to the working tree.
+Without a trace a synthetic one is used: gyro noise and vibration, stick moves,
+throttle punches into both mixer limits and a part with CH_AUX2 on.
+The trace format is described in replay.c, the variants are set like in sweep.py.
+"""
+import argparse
+import math
+import os
+import random
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TOP = os.path.abspath(os.path.join(HERE, "..", ".."))
+
+# the stock config, then the mixer and kalman options on and off
+VARIANTS = [
+    ("stock", []),
+    ("no_mix", [("!MIX_LOWER_THROTTLE", ""), ("!MIX_INCREASE_THROTTLE_3", "")]),
+    ("mix1", [("!MIX_INCREASE_THROTTLE_3", ""), ("MIX_INCREASE_THROTTLE", "")]),
+    ("mix3", [("!MIX_LOWER_THROTTLE", ""), ("MIX_LOWER_THROTTLE_3", "")]),
+    ("clip_ff", [("CLIP_FF", ""), ("TORQUE_BOOST", "1.0")]),
+    ("inverted", [("INVERTED_ENABLE", ""), ("FN_INVERTED", "CH_AUX2")]),
+    ("motor_kal", [("!MOTOR_FILTER2_ALPHA", ""), ("MOTOR_KAL", "HZ_70")]),
+    ("gyro_kal2", [("GYRO_FILTER_PASS2", "HZ_90")]),
+]
+
+
+def synthetic_trace(path, seconds=6.0, looptime=1000):
+    rnd = random.Random(1)
+    with open(path, "w") as f:
+        f.write("# synthetic trace for equivalence.py\n")
+        for n in range(int(seconds * 1e6 / looptime)):
+            t = n * looptime * 1e-6
+            gyro = [rnd.gauss(0, 30) + 200 * math.sin(2 * math.pi * (180 + 40 * axis) * t)
+                    + 2000 * math.sin(2 * math.pi * 1.3 * t + axis) for axis in range(3)]
+            accel = [rnd.gauss(0, 20), rnd.gauss(0, 20), 2048 + rnd.gauss(0, 40)]
+            # sticks sweep both ways, throttle from idle to full punches
+            rx = [0.8 * math.sin(2 * math.pi * 0.7 * t + axis) for axis in range(3)]
+            rx.append(min(1.0, max(0.0, 0.5 + 0.6 * math.sin(2 * math.pi * 0.4 * t))))
+            # the last part flies inverted with FN_INVERTED on CH_AUX2
+            aux = 1 << 5 if t > 0.7 * seconds else 0
+            row = [n * looptime] + gyro + accel + rx + [aux]
+            f.write(",".join("%.6g" % v for v in row) + "\n")
+
+
+def export(rev, workdir):
+    """The replay and src directories of a git revision, None for the working tree."""
+    if rev is None:
+        return HERE
+    dest = os.path.join(workdir, "rev_" + "".join(c if c.isalnum() else "_" for c in rev))
+    if not os.path.isdir(dest):
+        os.makedirs(dest)
+        archive = subprocess.Popen(["git", "-C", TOP, "archive", rev, "Silverware/src", "Silverware/replay"],
+                                   stdout=subprocess.PIPE)
+        subprocess.check_call(["tar", "-x", "-C", dest], stdin=archive.stdout)
+        if archive.wait():
+            sys.exit("git archive %s failed" % rev)
+    return os.path.join(dest, "Silverware", "replay")
+
+
+def build(replay_dir, out, defines):
+    os.makedirs(out, exist_ok=True)
+    header = os.path.join(out, "override.h")
+    with open(header, "w") as f:
+        for define, value in defines:
+            if define.startswith("!"):
+                f.write("#undef %s\n" % define[1:])
+            else:
+                f.write("#undef %s\n#define %s %s\n" % (define, define, value))
+    # the libraries come from this tree, an exported revision has only the sources
+    result = subprocess.run(["make", "-s", "-C", replay_dir, "topdir=" + TOP, "OUT=" + out, "OVERRIDE=" + header],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode:
+        errors = [line for line in result.stdout.splitlines() if "error" in line]
+        return None, errors[:1]
+    return os.path.join(out, "replay"), None
+
+
+def check(variant, trace, base_dir, new_dir, workdir, tolerance):
+    name, defines = variant
+    base, error = build(base_dir, os.path.join(workdir, name, "base"), defines)
+    if base is None:
+        return name, False, "baseline build: " + " ".join(error)
+    new, error = build(new_dir, os.path.join(workdir, name, "new"), defines)
+    if new is None:
+        return name, False, "new build: " + " ".join(error)
+
+    base_out = os.path.join(workdir, name, "base.csv")
+    result = subprocess.run([base, trace, base_out],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode:
+        return name, False, "baseline run: " + result.stdout.strip()
+    # the new replay compares with the baseline output, last line is the summary
+    result = subprocess.run([new, trace, os.path.join(workdir, name, "new.csv"), base_out, "%g" % tolerance],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    return name, result.returncode == 0, result.stdout.strip().splitlines()[-1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace", nargs="?", help="replay trace, synthetic if not given")
+    parser.add_argument("--base", required=True, help="git revision of the baseline")
+    parser.add_argument("--new", help="git revision to check, default the working tree")
+    parser.add_argument("--tolerance", type=float, default=1e-6)
+    parser.add_argument("--jobs", type=int, default=os.cpu_count())
+    args = parser.parse_args()
+
+    workdir = tempfile.mkdtemp(prefix="equivalence")
+    trace = args.trace and os.path.abspath(args.trace)
+    if not trace:
+        trace = os.path.join(workdir, "trace.csv")
+        synthetic_trace(trace)
+
+    base_dir = export(args.base, workdir)
+    new_dir = export(args.new, workdir)
+    with ThreadPoolExecutor(args.jobs) as pool:
+        results = list(pool.map(lambda v: check(v, trace, base_dir, new_dir, workdir, args.tolerance), VARIANTS))
+
+    failed = 0
+    for name, ok, text in results:
+        print("%-12s %-5s %s" % (name, "ok" if ok else "FAIL", text))
+        failed += not ok
+    print("builds in %s" % workdir)
+    if failed:
+        sys.exit("%d of %d variants differ from %s" % (failed, len(results), args.base))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,282 @@
+// flight log replay on the pc
+// runs the real gyro filters, control(), pid() and imu_calc() from ../src
+// over a recorded trace, and writes pidoutput and the motor commands
+// optionally compares them against a baseline output of an earlier build
+//
+// make
+// build/replay trace.csv out.csv
+// build/replay trace.csv out.csv baseline.csv 1e-6
+// build/replay -p pidkp=0.2,0.2,1.0 -p pidkd=0.8,0.8,0.5 trace.csv out.csv
+//
+// make OVERRIDE=file.h builds with the filter defines of file.h ( see config.h )
+//
+// trace, one loop per line ( "#" lines are comments ):
+// time_us, gyro x y z, accel x y z, rx 0 1 2 3, aux
+// gyro in sensor units as in GYRO_CAPTURE ( 0.061 deg/s, after the gyro cal )
+// accel in sensor units, rx as in rx[], aux as a bit mask of aux[]
+//
+// output: time_us, pidoutput 0 1 2, motor 0 1 2 3, filtered gyro x y z ( rad/s )
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "config.h"
+#include "defines.h"
+
+void control( void);
+void imu_calc( void);
+void gyro_filter( float gyronew[3] );
+extern float pidoutput[PIDNUMBER];
+extern float pidkp[PIDNUMBER];
+extern float pidki[PIDNUMBER];
+extern float pidkd[PIDNUMBER];
+
+// globals normally in main.c and sixaxis.c, set from the trace
+float looptime = LOOPTIME * 1e-6f;
+float gyro[3];
+float accel[3];
+float accelcal[3];
+float rx[4];
+char aux[AUXNUMBER];
+char auxchange[AUXNUMBER];
+float vbattfilt = 4.2f;
+float vbatt_comp = 4.2f;
+int in_air;
+int armed_state;
+int arming_release;
+int binding_while_armed = 0;
+int rx_ready = 1;
+int failsafe = 0;
+int ledcommand = 0;
+int flash_feature_1 = 0;
+int flash_feature_2 = 0;
+int pwmdir = FORWARD;
+
+unsigned long replay_time;
+float motor[4];
+
+// hardware used by the control code
+void pwm_set( uint8_t number , float pwm)
+{
+	if ( number < 4 ) motor[number] = pwm;
+}
+
+unsigned long gettime( void)
+{
+	return replay_time;
+}
+
+void delay( uint32_t data)
+{
+}
+
+void sixaxis_read( void)
+{
+}
+
+#define TRACE_COLUMNS 12
+#define OUT_COLUMNS 11
+
+static int read_line( FILE * f , double * v , int count )
+{
+	char line[512];
+
+	while ( fgets( line , sizeof( line ) , f ) )
+	{
+		if ( line[0] == '#' ) continue;
+
+		char * p = line;
+		int n = 0;
+		while ( n < count )
+		{
+			char * end;
+			v[n] = strtod( p , &end );
+			if ( end == p ) break;
+			n++;
+			p = end;
+			while ( *p == ',' || *p == ' ' || *p == '\t' ) p++;
+		}
+		if ( n == count ) return 1;
+	}
+	return 0;
+}
+
+static double seconds( void)
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC , &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// -p pidkp=a,b,c
+static int set_pids( const char * arg )
+{
+	float * pids = NULL;
+	if ( !strncmp( arg , "pidkp=" , 6 ) ) pids = pidkp;
+	if ( !strncmp( arg , "pidki=" , 6 ) ) pids = pidki;
+	if ( !strncmp( arg , "pidkd=" , 6 ) ) pids = pidkd;
+	if ( !pids ) return 0;
+
+	const char * p = arg + 6;
+	for ( int i = 0 ; i < PIDNUMBER ; i++ )
+	{
+		char * end;
+		pids[i] = strtof( p , &end );
+		if ( end == p ) return 0;
+		p = end;
+		if ( *p == ',' ) p++;
+	}
+	return 1;
+}
+
+int main( int argc , char * argv[] )
+{
+	while ( argc > 2 && !strcmp( argv[1] , "-p" ) )
+	{
+		if ( !set_pids( argv[2] ) )
+		{
+			fprintf( stderr , "replay: bad pid setting %s\n" , argv[2] );
+			return 2;
+		}
+		argc -= 2;
+		argv += 2;
+	}
+
+	if ( argc < 3 )
+	{
+		fprintf( stderr , "usage: replay [ -p pidkp=a,b,c ]... trace.csv out.csv [ baseline.csv [ tolerance ] ]\n" );
+		return 2;
+	}
+
+	FILE * in = fopen( argv[1] , "r" );
+	FILE * out = fopen( argv[2] , "w" );
+	FILE * base = argc > 3 ? fopen( argv[3] , "r" ) : NULL;
+	double tolerance = argc > 4 ? atof( argv[4] ) : 0;
+
+	if ( !in || !out || ( argc > 3 && !base ) )
+	{
+		fprintf( stderr , "replay: can't open files\n" );
+		return 2;
+	}
+
+	fprintf( out , "# time_us, pidoutput 0 1 2, motor 0 1 2 3, gyro 0 1 2\n" );
+
+	double v[TRACE_COLUMNS];
+	int samples = 0;
+	int mismatches = 0;
+	double maxdiff = 0;
+	double busy = 0;
+	unsigned long lasttime = 0;
+
+	while ( read_line( in , v , TRACE_COLUMNS ) )
+	{
+		replay_time = (unsigned long) v[0];
+		if ( samples )
+		{
+			looptime = ( replay_time - lasttime ) * 1e-6f;
+			if ( looptime <= 0 ) looptime = 1e-6f;
+		}
+		lasttime = replay_time;
+
+		float gyronew[3];
+		for ( int i = 0 ; i < 3 ; i++ )
+		{
+			gyronew[i] = v[1 + i];
+			accel[i] = v[4 + i];
+		}
+		for ( int i = 0 ; i < 4 ; i++ )
+		{
+			rx[i] = v[7 + i];
+			motor[i] = 0;
+		}
+
+		unsigned long auxbits = (unsigned long) v[11];
+		for ( int i = 0 ; i < AUXNUMBER ; i++ )
+		{
+			char a = ( auxbits >> i ) & 1;
+			if ( i == CH_ON ) a = 1;
+			if ( i == CH_OFF ) a = 0;
+			auxchange[i] = a != aux[i];
+			aux[i] = a;
+		}
+
+		// same order as the main loop
+		double start = seconds();
+		gyro_filter( gyronew );
+		control();
+		imu_calc();
+		busy += seconds() - start;
+
+		double result[OUT_COLUMNS];
+		result[0] = replay_time;
+		for ( int i = 0 ; i < 3 ; i++ ) result[1 + i] = pidoutput[i];
+		for ( int i = 0 ; i < 4 ; i++ ) result[4 + i] = motor[i];
+		for ( int i = 0 ; i < 3 ; i++ ) result[8 + i] = gyro[i];
+
+		fprintf( out , "%lu" , replay_time );
+		for ( int i = 1 ; i < OUT_COLUMNS ; i++ ) fprintf( out , ",%.9g" , result[i] );
+		fprintf( out , "\n" );
+
+		if ( base )
+		{
+			double b[OUT_COLUMNS];
+			if ( !read_line( base , b , OUT_COLUMNS ) )
+			{
+				fprintf( stderr , "replay: baseline ends at sample %d\n" , samples );
+				mismatches++;
+				fclose( base );
+				base = NULL;
+			}
+			else
+			{
+				int bad = 0;
+				for ( int i = 1 ; i < OUT_COLUMNS ; i++ )
+				{
+					// 9 digits round trip a float exactly
+					double d = fabs( (float) result[i] - (float) b[i] );
+					if ( d > maxdiff ) maxdiff = d;
+					if ( d > tolerance ) bad = 1;
+				}
+				if ( bad && mismatches++ < 10 )
+					fprintf( stderr , "replay: sample %d ( %lu us ) differs from the baseline\n" , samples , replay_time );
+			}
+		}
+
+		samples++;
+	}
+
+	if ( base )
+	{
+		// a longer baseline is a mismatch too
+		double b[OUT_COLUMNS];
+		if ( read_line( base , b , OUT_COLUMNS ) )
+		{
+			fprintf( stderr , "replay: baseline has more samples than the trace ( %d )\n" , samples );
+			mismatches++;
+		}
+		fclose( base );
+	}
+
+	fclose( in );
+	fclose( out );
+
+	if ( !samples )
+	{
+		fprintf( stderr , "replay: no samples in %s\n" , argv[1] );
+		return 2;
+	}
+
+	fprintf( stderr , "%d samples, %.0f ns per sample\n" , samples , busy * 1e9 / samples );
+
+	if ( argc > 3 )
+	{
+		fprintf( stderr , "%d samples over tolerance %g, max difference %g\n" , mismatches , tolerance , maxdiff );
+		if ( mismatches ) return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,743 @@
+// rx decoder tests on the pc
+// serial rx ( sbus, crsf, dsmx ): bytes through USART1_IRQHandler() and checkrx()
+// xn297 rx ( bayang, cg023, h7, cx10blue ): packets through the radio model in
+// rxtest_xn297.c, read by the unchanged drv_xn297 code and checkrx()
+// one driver from ../src per build
+//
+// golden frames: decoded rx[], aux[] and failsafe must match
+// fuzz: frames mutated with bit flips, byte changes, drops, inserts and line
+// gaps ( serial ) or drops, repeats, wrong channels and addresses and timing
+// changes ( xn297 ), the decoder must not access memory out of bounds ( asan
+// build ), must keep rx[] in range and must decode clean frames again afterwards
+// bench: time per frame for the interrupt bytes or packet and the decode
+//
+// make test
+// build/rxtest_sbus [ iterations [ seed ] ]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "project.h"
+#include "config.h"
+#include "defines.h"
+#include "drv_time.h"
+
+void rx_init( void);
+void checkrx( void);
+void USART1_IRQHandler( void);
+extern int failsafe;
+
+// globals normally in main.c
+float rx[4];
+char aux[AUXNUMBER];
+char lastaux[AUXNUMBER];
+char auxchange[AUXNUMBER];
+unsigned long lastlooptime;
+
+// read by the telemetry and the ble beacons
+int lowbatt;
+float vbattfilt = 4.0f;
+float vbatt_comp = 4.0f;
+int onground = 1;
+int random_seed;
+float pidkp[PIDNUMBER];
+float pidki[PIDNUMBER];
+float pidkd[PIDNUMBER];
+int current_pid_axis;
+int current_pid_term;
+
+// simulated time, the drivers wait 2s after powerup before taking the pin
+static unsigned long now = 3000000;
+static unsigned long next_loop = 3000000;
+static uint8_t usart_byte;
+
+unsigned long gettime( void)
+{
+	return now;
+}
+
+void delay( uint32_t data)
+{
+	now += data;
+}
+
+// hardware used by the drivers
+uint16_t USART_ReceiveData( USART_TypeDef* USARTx )
+{
+	return usart_byte;
+}
+
+FlagStatus USART_GetFlagStatus( USART_TypeDef* USARTx , uint32_t USART_FLAG )
+{
+	return RESET;
+}
+
+void USART_ClearFlag( USART_TypeDef* USARTx , uint32_t USART_FLAG ) {}
+void USART_Init( USART_TypeDef* USARTx , USART_InitTypeDef* USART_InitStruct ) {}
+void USART_Cmd( USART_TypeDef* USARTx , FunctionalState NewState ) {}
+void USART_InvPinCmd( USART_TypeDef* USARTx , uint32_t USART_InvPin , FunctionalState NewState ) {}
+void USART_SWAPPinCmd( USART_TypeDef* USARTx , FunctionalState NewState ) {}
+void USART_ITConfig( USART_TypeDef* USARTx , uint32_t USART_IT , FunctionalState NewState ) {}
+void GPIO_Init( GPIO_TypeDef* GPIOx , GPIO_InitTypeDef* GPIO_InitStruct ) {}
+void GPIO_SetBits( GPIO_TypeDef* GPIOx , uint16_t GPIO_Pin ) {}
+void GPIO_ResetBits( GPIO_TypeDef* GPIOx , uint16_t GPIO_Pin ) {}
+void GPIO_PinAFConfig( GPIO_TypeDef* GPIOx , uint16_t GPIO_PinSource , uint8_t GPIO_AF ) {}
+void RCC_APB2PeriphClockCmd( uint32_t RCC_APB2Periph , FunctionalState NewState ) {}
+void NVIC_Init( NVIC_InitTypeDef* NVIC_InitStruct ) {}
+
+float fmc_read_float( unsigned long address )
+{
+	return 0;
+}
+
+// RADIO_CHECK
+void failloop( int val )
+{
+	printf( "failloop %d\n" , val );
+	exit( 1 );
+}
+
+// the xn297 model
+void xn297_air( const uint8_t * payload , int size , int channel , const uint8_t address[5] );
+extern uint8_t xn297_txdata[32];
+extern int xn297_txcount;
+
+// golden frames, made with an encoder independent of the drivers
+// expected values from the driver scaling, aux from CHAN_5 on, -1 not checked
+typedef struct
+{
+	const uint8_t * frame[2];
+	float rx[4];
+	signed char aux[6];
+	int failsafe;
+} golden_type;
+
+#ifdef RX_SBUS
+#define PROTOCOL "sbus"
+// 100000 baud 8E2, one frame every 14ms
+#define BYTE_US 120
+#define FRAME_US 14000
+#define FRAME_SIZE 25
+
+// roll full right, pitch full down, throttle full, aux on off on off on
+static const uint8_t sbus1[FRAME_SIZE] = { 0x0F, 0x13, 0x67, 0xC5, 0xC4, 0xC3, 0x37, 0x71, 0x56, 0x4C, 0x9C, 0x15,
+	0x13, 0x0F, 0x5F, 0xF8, 0xC2, 0x17, 0xBE, 0xF0, 0x85, 0x2F, 0x7C, 0x00, 0x00 };
+// yaw 1200, throttle low, aux off on off on off, failsafe flag
+static const uint8_t sbus2[FRAME_SIZE] = { 0x0F, 0xE1, 0x0B, 0x5F, 0x2B, 0x60, 0xC9, 0x8A, 0x89, 0xB3, 0x62, 0xE2,
+	0xAC, 0x08, 0x5F, 0xF8, 0xC2, 0x17, 0xBE, 0xF0, 0x85, 0x2F, 0x7C, 0x08, 0x00 };
+
+static const golden_type golden[] =
+{
+	{ { sbus1 } , { 0.99817268f , -1.00183346f , 0.0f , 0.99939466f } , { 1 , 0 , 1 , 0 , 1 , -1 } , 0 },
+	{ { sbus2 } , { 0.0f , 0.0f , 0.25259382f , 0.0f } , { 0 , 1 , 0 , 1 , 0 , -1 } , 1 },
+};
+// low throttle frame for the arming wait
+#define STARTUP_FRAME 1
+#endif
+
+#ifdef RX_CRSF
+#define PROTOCOL "crsf"
+// 420000 baud, one frame every 4ms
+#define BYTE_US 24
+#define FRAME_US 4000
+#define FRAME_SIZE 26
+
+// roll full, pitch full, yaw center, throttle full, aux on off on off on off
+static const uint8_t crsf1[FRAME_SIZE] = { 0xC8, 0x18, 0x16, 0x13, 0x67, 0xC5, 0xC4, 0xC1, 0x37, 0x71, 0x56, 0x4C, 0x9C,
+	0x15, 0x13, 0x67, 0x05, 0xF8, 0xC0, 0x07, 0x3E, 0xF0, 0x81, 0x0F, 0x7C, 0x0C };
+// roll 500, pitch 1500, yaw 1200, throttle low, aux off on off on off on
+static const uint8_t crsf2[FRAME_SIZE] = { 0xC8, 0x18, 0x16, 0xF4, 0xE1, 0xEE, 0x2F, 0x60, 0xC9, 0x8A, 0x89, 0xB3, 0x62,
+	0xE2, 0xAC, 0x98, 0x38, 0xF8, 0xC0, 0x07, 0x3E, 0xF0, 0x81, 0x0F, 0x7C, 0xE0 };
+
+static const golden_type golden[] =
+{
+	{ { crsf1 } , { 1.03142678f , -1.02891264f , 0.00188561f , 1.0f } , { 1 , 0 , 1 , 0 , 1 , 0 } , 0 },
+	{ { crsf2 } , { -0.61659334f , 0.64047769f , 0.26335638f , 0.0f } , { 0 , 1 , 0 , 1 , 0 , 1 } , 0 },
+};
+#define STARTUP_FRAME 1
+#endif
+
+#ifdef RX_DSMX_2048
+#define PROTOCOL "dsmx"
+// 115200 baud, 11ms frames, 10 channels in two frames
+#define BYTE_US 87
+#define FRAME_US 11000
+#define FRAME_SIZE 16
+
+// throttle 2047, roll 1700, pitch 342, yaw 1024, aux 1500 600 2000
+static const uint8_t dsma[FRAME_SIZE] = { 0x00, 0xB2, 0x07, 0xFF, 0x0E, 0xA4, 0x11, 0x56, 0x1C, 0x00, 0x25, 0xDC,
+	0x2A, 0x58, 0x37, 0xD0 };
+// aux 1200 300 1900, unused slots
+static const uint8_t dsmb[FRAME_SIZE] = { 0x00, 0xB2, 0x3C, 0xB0, 0x41, 0x2C, 0x4F, 0x6C, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF };
+
+static const golden_type golden[] =
+{
+	{ { dsma , dsmb } , { 0.66080154f , -0.66666664f , 0.0f , 1.0f } , { 1 , 0 , 1 , 1 , 0 , 1 } , 0 },
+};
+#define STARTUP_FRAME 0
+#endif
+
+// xn297 protocols: the transmitter binds on BIND_CHANNEL and bind_address for
+// BIND_US, then sends one data packet every FRAME_US, on channel hop( n ) for
+// the nth packet, to address
+
+#if defined RX_BAYANG_PROTOCOL || defined RX_BAYANG_PROTOCOL_TELEMETRY || defined RX_BAYANG_PROTOCOL_TELEMETRY_AUTOBIND \
+	|| defined RX_BAYANG_PROTOCOL_BLE_BEACON || defined RX_BAYANG_BLE_APP
+#define XN297
+#ifdef RX_BAYANG_PROTOCOL
+#define PROTOCOL "bayang"
+#endif
+#ifdef RX_BAYANG_PROTOCOL_TELEMETRY
+#define PROTOCOL "bayang telemetry"
+#define TELEMETRY_REPLY
+#endif
+#ifdef RX_BAYANG_PROTOCOL_TELEMETRY_AUTOBIND
+#define PROTOCOL "bayang autobind"
+#define TELEMETRY_REPLY
+#endif
+#ifdef RX_BAYANG_PROTOCOL_BLE_BEACON
+#define PROTOCOL "bayang ble"
+#define BEACON
+#endif
+#ifdef RX_BAYANG_BLE_APP
+#define PROTOCOL "bayang ble app"
+#define BEACON
+#endif
+#define FRAME_SIZE 15
+#define BIND_CHANNEL 0
+#define BIND_US 1000000
+
+#ifdef TELEMETRY_REPLY
+// 0xa3 bind, telemetry on, the transmitter listens between packets
+#define FRAME_US 5000
+static const uint8_t bindpacket[FRAME_SIZE] = { 0xA3, 0x3C, 0x55, 0x9A, 0x21, 0x6E, 0x0E, 0x21, 0x35, 0x42, 0x00, 0x00, 0x00, 0x00, 0x03 };
+#else
+#define FRAME_US 2000
+static const uint8_t bindpacket[FRAME_SIZE] = { 0xA4, 0x3C, 0x55, 0x9A, 0x21, 0x6E, 0x0E, 0x21, 0x35, 0x42, 0x00, 0x00, 0x00, 0x00, 0x04 };
+#endif
+static const uint8_t bind_address[5] = { 0 , 0 , 0 , 0 , 0 };
+static const uint8_t address[5] = { 0x3C , 0x55 , 0x9A , 0x21 , 0x6E };
+
+// the 4 channels from the bind packet in turn
+static int hop( int n )
+{
+	return bindpacket[ 6 + ( n & 3 ) ];
+}
+
+// roll 1023, pitch 0, throttle 1023, yaw 512, expert, flip, rth, video, inverted
+static const uint8_t bayang1[FRAME_SIZE] = { 0xA5, 0xFA, 0x19, 0x80, 0x83, 0xFF, 0x80, 0x00, 0x83, 0xFF, 0x82, 0x00, 0x00, 0x0A, 0x48 };
+// roll 256, pitch 768, throttle 0, yaw 600, headfree
+static const uint8_t bayang2[FRAME_SIZE] = { 0xA5, 0x00, 0x02, 0x00, 0x81, 0x00, 0x83, 0x00, 0x80, 0x00, 0x82, 0x58, 0x00, 0x0A, 0x0F };
+
+static const golden_type golden[] =
+{
+	{ { bayang1 } , { 0.99804688f , -1.0f , 0.0f , 0.99902293f } , { 1 , 1 , 0 , 1 , 1 , 1 } , 0 },
+	{ { bayang2 } , { -0.5f , 0.5f , 0.171875f , 0.0f } , { 0 , 0 , 1 , 0 , 0 , 0 } , 0 },
+};
+#define AUX_CHANNELS { CH_FLIP , CH_EXPERT , CH_HEADFREE , CH_RTH , CH_INV , CH_VID }
+#define STARTUP_FRAME 1
+#endif
+
+#ifdef RX_CG023_PROTOCOL
+#define PROTOCOL "cg023"
+#define XN297
+#define FRAME_SIZE 15
+#define FRAME_US 8200
+#define BIND_CHANNEL 0x2D
+#define BIND_US 1000000
+
+// tx id a0 3b, data channel a0 - 7d
+static const uint8_t bindpacket[FRAME_SIZE] = { 0xAA, 0xA0, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static const uint8_t bind_address[5] = { 0x26 , 0xA8 , 0x67 , 0x35 , 0xCC };
+static const uint8_t address[5] = { 0x26 , 0xA8 , 0x67 , 0x35 , 0xCC };
+
+static int hop( int n )
+{
+	return 0x23;
+}
+
+// throttle full, roll full, pitch full down, yaw center, 100% rate, flip, still
+static const uint8_t cg023_1[FRAME_SIZE] = { 0x55, 0xA0, 0x3B, 0x00, 0x00, 0xFF, 0x3C, 0xBB, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x49, 0x00 };
+// throttle low, 60% rate, video, led off
+static const uint8_t cg023_2[FRAME_SIZE] = { 0x55, 0xA0, 0x3B, 0x00, 0x00, 0x00, 0xA0, 0x60, 0x90, 0x00, 0x00, 0x00, 0x00, 0x34, 0x00 };
+
+static const golden_type golden[] =
+{
+	{ { cg023_1 } , { 1.0f , -0.999996f , 0.0f , 0.99609375f } , { 1 , 0 , 1 , 0 , -1 , -1 } , 0 },
+	{ { cg023_2 } , { -0.32999868f , 0.30999876f , -0.16999932f , 0.0f } , { 0 , 1 , 0 , 1 , -1 , -1 } , 0 },
+};
+#define AUX_CHANNELS { CH_CG023_FLIP , CH_CG023_VIDEO , CH_CG023_STILL , CH_CG023_LED , CH_OFF , CH_OFF }
+#define STARTUP_FRAME 1
+#endif
+
+#ifdef RX_H7_PROTOCOL
+#define PROTOCOL "h7"
+#define XN297
+#define FRAME_SIZE 9
+// 16 hops in less than the 28ms the rx waits on a channel
+#define FRAME_US 1500
+#define BIND_CHANNEL 22
+#define BIND_US 1000000
+
+// address 5a a7, checksum offset 36, channel offset ( 3 + 6 ) % 8
+static const uint8_t bindpacket[FRAME_SIZE] = { 0x20, 0x00, 0x00, 0x00, 0x5A, 0xA7, 0x00, 0x36, 0x00 };
+static const uint8_t bind_address[5] = { 0xCC , 0xCC , 0xCC , 0xCC , 0xCC };
+static const uint8_t address[5] = { 0x5A , 0xA7 , 0x00 , 0xCC , 0xCC };
+
+// the rx starts on the second channel after the bind
+static int hop( int n )
+{
+	static const uint8_t freq[16] = { 0x02, 0x48, 0x0C, 0x3e, 0x16, 0x34, 0x20, 0x2A, 0x2A, 0x20, 0x34, 0x16, 0x3e, 0x0c, 0x48, 0x02 };
+	return freq[ ( n + 1 ) & 15 ] + 1;
+}
+
+// throttle full, roll full right, pitch full down, flip, f/s
+static const uint8_t h7_1[FRAME_SIZE] = { 0x03, 0x70, 0xE0, 0x00, 0x20, 0x20, 0x81, 0x00, 0x4A };
+// throttle low, yaw 56, roll 90, pitch 150, video
+static const uint8_t h7_2[FRAME_SIZE] = { 0xE1, 0x38, 0x5A, 0x96, 0x20, 0x20, 0x10, 0x00, 0x8F };
+
+static const golden_type golden[] =
+{
+	{ { h7_1 } , { 0.99555456f , -0.99555456f , 0.0f , 0.999f } , { 1 , 0 , 1 , -1 , -1 , -1 } , 0 },
+	{ { h7_2 } , { -0.19555536f , 0.33777744f , 0.49777728f , 0.0f } , { 0 , 1 , 0 , -1 , -1 , -1 } , 0 },
+};
+#define AUX_CHANNELS { CH_H7_FLIP , CH_H7_VIDEO , CH_H7_FS , CH_OFF , CH_OFF , CH_OFF }
+#define STARTUP_FRAME 1
+#endif
+
+#ifdef RX_CX10BLUE_PROTOCOL
+#define PROTOCOL "cx10blue"
+#define XN297
+#define FRAME_SIZE 19
+#define FRAME_US 1316
+#define BIND_CHANNEL 2
+#define BIND_US 1000000
+
+// channels 5 1b 30 01 from bytes 1 and 2
+static const uint8_t bindpacket[FRAME_SIZE] = { 0xAA, 0x52, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static const uint8_t bind_address[5] = { 0xCC , 0xCC , 0xCC , 0xCC , 0xCC };
+static const uint8_t address[5] = { 0xCC , 0xCC , 0xCC , 0xCC , 0xCC };
+
+// the rx starts on the second channel after the bind
+static int hop( int n )
+{
+	static const uint8_t channels[4] = { 0x05 , 0x1B , 0x30 , 0x01 };
+	return channels[ ( n + 1 ) & 3 ];
+}
+
+// aileron 1000, elevator 2000, throttle 2000, rudder 1500, rate
+// ( the flip flag 0x10 shares byte 16 with the rudder, not in the golden packets )
+static const uint8_t cx10_1[FRAME_SIZE] = { 0x55, 0x11, 0x22, 0x33, 0x44, 0x00, 0x00, 0x00, 0x00, 0xE8, 0x03, 0xD0, 0x07, 0xD0, 0x07, 0xDC, 0x05, 0x01, 0x00 };
+// aileron 1500, elevator 1250, throttle 1000, rudder 1800
+static const uint8_t cx10_2[FRAME_SIZE] = { 0x55, 0x11, 0x22, 0x33, 0x44, 0x00, 0x00, 0x00, 0x00, 0xDC, 0x05, 0xE2, 0x04, 0xE8, 0x03, 0x08, 0x07, 0x00, 0x00 };
+
+static const golden_type golden[] =
+{
+	{ { cx10_1 } , { 1.0f , -1.0f , 0.0f , 1.0f } , { 0 , 1 , -1 , -1 , -1 , -1 } , 0 },
+	{ { cx10_2 } , { 0.0f , 0.5f , 0.6f , 0.0f } , { 0 , 0 , -1 , -1 , -1 , -1 } , 0 },
+};
+#define AUX_CHANNELS { CH_CX10_CH0 , CH_CX10_CH2 , CH_OFF , CH_OFF , CH_OFF , CH_OFF }
+#define STARTUP_FRAME 1
+#endif
+
+#define GOLDEN_COUNT ( (int) ( sizeof( golden ) / sizeof( golden[0] ) ) )
+
+#ifndef AUX_CHANNELS
+#define AUX_CHANNELS { CHAN_5 , CHAN_6 , CHAN_7 , CHAN_8 , CHAN_9 , CHAN_10 }
+#endif
+static const int auxchannel[6] = AUX_CHANNELS;
+
+// the main loop runs checkrx() every LOOPTIME while the bytes come in
+static void run_until( unsigned long time )
+{
+	while ( (long) ( next_loop - time ) <= 0 )
+	{
+		now = next_loop;
+		checkrx();
+		next_loop += LOOPTIME;
+		// a checkrx() longer than the loop ( cx10 bind reply ) delays the next one like in main.c
+		if ( (long) ( now - next_loop ) > 0 ) next_loop = now;
+	}
+	if ( (long) ( time - now ) > 0 ) now = time;
+}
+
+#ifdef XN297
+// the transmitter position in its hop sequence
+static int packet_count;
+
+static void send_packet( const uint8_t * packet , int channel , const uint8_t * to , unsigned long gap )
+{
+	run_until( now + gap );
+	xn297_air( packet , FRAME_SIZE , channel , to );
+}
+
+static void send_frame( const uint8_t * frame , int size )
+{
+	unsigned long start = now;
+	send_packet( frame , hop( packet_count++ ) , address , 0 );
+	run_until( start + FRAME_US );
+}
+
+static void bind( void)
+{
+	unsigned long start = now;
+	while ( now - start < BIND_US ) send_packet( bindpacket , BIND_CHANNEL , bind_address , FRAME_US );
+}
+#else
+static void send_byte( uint8_t byte , unsigned long gap )
+{
+	run_until( now + gap );
+	usart_byte = byte;
+	USART1_IRQHandler();
+}
+
+static void send_frame( const uint8_t * frame , int size )
+{
+	unsigned long start = now;
+	for ( int i = 0 ; i < size ; i++ ) send_byte( frame[i] , BYTE_US );
+	run_until( start + FRAME_US );
+}
+#endif
+
+static void send_golden( const golden_type * g , int repeat )
+{
+	for ( int i = 0 ; i < repeat ; i++ )
+		for ( int j = 0 ; j < 2 && g->frame[j] ; j++ ) send_frame( g->frame[j] , FRAME_SIZE );
+}
+
+static int check_golden( const golden_type * g , const char * name )
+{
+	int errors = 0;
+	for ( int i = 0 ; i < 4 ; i++ )
+	{
+		if ( fabsf( rx[i] - g->rx[i] ) > 1e-5f )
+		{
+			printf( "%s: rx[%d] %.8f, expected %.8f\n" , name , i , rx[i] , g->rx[i] );
+			errors++;
+		}
+	}
+	for ( int i = 0 ; i < 6 ; i++ )
+	{
+		if ( g->aux[i] >= 0 && aux[ auxchannel[i] ] != g->aux[i] )
+		{
+			printf( "%s: aux[%d] %d, expected %d\n" , name , auxchannel[i] , aux[ auxchannel[i] ] , g->aux[i] );
+			errors++;
+		}
+	}
+	if ( failsafe != g->failsafe )
+	{
+		printf( "%s: failsafe %d, expected %d\n" , name , failsafe , g->failsafe );
+		errors++;
+	}
+	return errors;
+}
+
+static int check_range( const char * name )
+{
+	for ( int i = 0 ; i < 4 ; i++ )
+	{
+		// 11 bit channels stay within about 1.35 after the scaling
+		if ( !isfinite( rx[i] ) || fabsf( rx[i] ) > 1.5f )
+		{
+			printf( "%s: rx[%d] out of range %g\n" , name , i , rx[i] );
+			return 1;
+		}
+	}
+	return 0;
+}
+
+#ifdef XN297
+// a burst of golden packets, one entry per packet with the time before it
+#define BURST_FRAMES 6
+#define BURST_MAX ( BURST_FRAMES * 2 )
+// clean packets to find the hop sequence again
+#define RESYNC_FRAMES ( 200000 / FRAME_US )
+
+typedef struct
+{
+	uint8_t packet[FRAME_SIZE];
+	int channel;
+	int other_address;
+	unsigned long gap;
+} event_type;
+
+static int make_burst( event_type * burst )
+{
+	for ( int n = 0 ; n < BURST_FRAMES ; n++ )
+	{
+		memcpy( burst[n].packet , golden[ rand() % GOLDEN_COUNT ].frame[0] , FRAME_SIZE );
+		burst[n].channel = hop( packet_count++ );
+		burst[n].other_address = 0;
+		burst[n].gap = FRAME_US;
+	}
+	return BURST_FRAMES;
+}
+
+// packets lost, repeated or from other transmitters, timing changes, several per burst
+static int mutate( event_type * burst , int n )
+{
+	int count = 1 + rand() % 4;
+	for ( int m = 0 ; m < count && n > 1 ; m++ )
+	{
+		int i = rand() % n;
+		switch ( rand() % 8 )
+		{
+		case 0:	// lost packet
+			memmove( &burst[i] , &burst[i + 1] , ( n - i - 1 ) * sizeof( event_type ) );
+			n--;
+			break;
+		case 1:	// repeated packet
+			if ( n < BURST_MAX )
+			{
+				memmove( &burst[i + 1] , &burst[i] , ( n - i ) * sizeof( event_type ) );
+				burst[i + 1].gap = rand() % FRAME_US;
+				n++;
+			}
+			break;
+		case 2:	// wrong channel
+			burst[i].channel = rand() % 128;
+			break;
+		case 3:	// another address on the channel
+			burst[i].other_address = 1;
+			break;
+		case 4:	// bit flip, a packet with a good crc from another transmitter
+			burst[i].packet[ rand() % FRAME_SIZE ] ^= 1 << ( rand() % 8 );
+			break;
+		case 5:	// random byte
+			burst[i].packet[ rand() % FRAME_SIZE ] = rand();
+			break;
+		case 6:	// transmitter pause
+			burst[i].gap = rand() % ( 20 * FRAME_US );
+			break;
+		case 7:	// timing jitter
+			burst[i].gap = FRAME_US / 2 + rand() % FRAME_US;
+			break;
+		}
+	}
+	return n;
+}
+
+static void send_event( const event_type * e )
+{
+	static const uint8_t other[5] = { 0x12 , 0x34 , 0x56 , 0x78 , 0x9A };
+	send_packet( e->packet , e->channel , e->other_address ? other : address , e->gap );
+}
+#else
+// a burst of golden frames, one byte per entry with the line idle time before it
+#define BURST_FRAMES 6
+#define BURST_MAX ( BURST_FRAMES * FRAME_SIZE * 2 )
+#define RESYNC_FRAMES 10
+
+typedef struct
+{
+	uint8_t byte;
+	unsigned long gap;
+} event_type;
+
+static int make_burst( event_type * burst )
+{
+	int n = 0;
+	for ( int f = 0 ; f < BURST_FRAMES ; f++ )
+	{
+		const golden_type * g = &golden[ rand() % GOLDEN_COUNT ];
+		for ( int j = 0 ; j < 2 && g->frame[j] ; j++ )
+			for ( int i = 0 ; i < FRAME_SIZE ; i++ )
+			{
+				burst[n].byte = g->frame[j][i];
+				burst[n].gap = i ? BYTE_US : FRAME_US - ( FRAME_SIZE - 1 ) * BYTE_US;
+				n++;
+			}
+	}
+	return n;
+}
+
+// libfuzzer style mutations, several per burst
+static int mutate( event_type * burst , int n )
+{
+	int count = 1 + rand() % 8;
+	for ( int m = 0 ; m < count && n > 1 ; m++ )
+	{
+		int i = rand() % n;
+		switch ( rand() % 8 )
+		{
+		case 0:	// bit flip
+			burst[i].byte ^= 1 << ( rand() % 8 );
+			break;
+		case 1:	// random byte
+			burst[i].byte = rand();
+			break;
+		case 2:	// interesting byte, start bytes and lengths
+		{
+			static const uint8_t interesting[] = { 0x00 , 0x0F , 0xC8 , 0x16 , 0x18 , 0xFF , 0x3F , 0x40 , 0x7F , 0x80 , 0x01 };
+			burst[i].byte = interesting[ rand() % sizeof( interesting ) ];
+			break;
+		}
+		case 3:	// drop a byte
+			memmove( &burst[i] , &burst[i + 1] , ( n - i - 1 ) * sizeof( event_type ) );
+			n--;
+			break;
+		case 4:	// insert a byte
+			if ( n < BURST_MAX )
+			{
+				memmove( &burst[i + 1] , &burst[i] , ( n - i ) * sizeof( event_type ) );
+				burst[i].byte = rand();
+				n++;
+			}
+			break;
+		case 5:	// line idle in the middle of a frame
+			burst[i].gap = rand() % ( 2 * FRAME_US );
+			break;
+		case 6:	// back to back frames, no idle time
+			burst[i].gap = BYTE_US;
+			break;
+		case 7:	// no idle time for the rest of the burst
+			for ( int j = i ; j < n ; j++ ) burst[j].gap = BYTE_US;
+			break;
+		}
+	}
+	return n;
+}
+
+static void send_event( const event_type * e )
+{
+	send_byte( e->byte , e->gap );
+}
+#endif
+
+static int fuzz( int iterations )
+{
+	static event_type burst[BURST_MAX];
+	int errors = 0;
+
+	for ( int it = 0 ; it < iterations && errors < 10 ; it++ )
+	{
+		int n = mutate( burst , make_burst( burst ) );
+		for ( int i = 0 ; i < n ; i++ )
+		{
+			send_event( &burst[i] );
+			errors += check_range( "fuzz" );
+		}
+
+		// the decoder has to pick up clean frames again
+		run_until( now + 2 * FRAME_US );
+		const golden_type * g = &golden[ it % GOLDEN_COUNT ];
+		send_golden( g , RESYNC_FRAMES );
+		char name[32];
+		sprintf( name , "fuzz %d resync" , it );
+		errors += check_golden( g , name );
+	}
+	return errors;
+}
+
+static double seconds( void)
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC , &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+#ifdef XN297
+// a packet in the fifo and the checkrx() calls of the main loop until the next one
+static void bench( int frames )
+{
+	double start = seconds();
+	for ( int f = 0 ; f < frames ; f++ )
+	{
+		unsigned long packet_time = now;
+		xn297_air( golden[ f % GOLDEN_COUNT ].frame[0] , FRAME_SIZE , hop( packet_count++ ) , address );
+		for ( ; (long) ( packet_time + FRAME_US - now ) > 0 ; now += LOOPTIME ) checkrx();
+		now = packet_time + FRAME_US;
+	}
+	double time = seconds() - start;
+	next_loop = now;
+	printf( "%s: %.0f ns per packet\n" , PROTOCOL , time * 1e9 / frames );
+}
+#else
+// interrupt bytes and two checkrx() calls per frame, like the main loop during a frame
+static void bench( int frames )
+{
+	double start = seconds();
+	for ( int f = 0 ; f < frames ; f++ )
+	{
+		const golden_type * g = &golden[ f % GOLDEN_COUNT ];
+		for ( int j = 0 ; j < 2 && g->frame[j] ; j++ )
+		{
+			for ( int i = 0 ; i < FRAME_SIZE ; i++ )
+			{
+				now += BYTE_US;
+				usart_byte = g->frame[j][i];
+				USART1_IRQHandler();
+			}
+			now += FRAME_US - FRAME_SIZE * BYTE_US;
+			checkrx();
+			checkrx();
+		}
+	}
+	double time = seconds() - start;
+	next_loop = now;
+	printf( "%s: %.0f ns per frame\n" , PROTOCOL , time * 1e9 / frames );
+}
+#endif
+
+int main( int argc , char * argv[] )
+{
+	int iterations = argc > 1 ? atoi( argv[1] ) : 5000;
+	srand( argc > 2 ? atoi( argv[2] ) : 1 );
+
+	// driver init, then enough frames to leave the bind and failsafe wait
+	rx_init();
+	run_until( now + 10000 );
+#ifdef XN297
+	bind();
+#endif
+	send_golden( &golden[STARTUP_FRAME] , 3000000 / FRAME_US );
+
+	int errors = 0;
+	for ( int i = 0 ; i < GOLDEN_COUNT ; i++ )
+	{
+		char name[32];
+		sprintf( name , "%s golden %d" , PROTOCOL , i + 1 );
+		send_golden( &golden[i] , 3 );
+		errors += check_golden( &golden[i] , name );
+	}
+
+#ifdef TELEMETRY_REPLY
+	// the telemetry sent back to the golden packets, 133 first and the sum last
+	int sum = 0;
+	for ( int i = 0 ; i < 14 ; i++ ) sum += xn297_txdata[i];
+	if ( !xn297_txcount || xn297_txdata[0] != 133 || ( sum & 0xff ) != xn297_txdata[14] )
+	{
+		printf( "%s: no telemetry packet\n" , PROTOCOL );
+		errors++;
+	}
+#endif
+#ifdef BEACON
+	// ble beacons between the packets
+	if ( !xn297_txcount )
+	{
+		printf( "%s: no beacon\n" , PROTOCOL );
+		errors++;
+	}
+#endif
+
+	errors += fuzz( iterations );
+
+	// no frames for longer than the failsafe time
+	run_until( now + 1500000 );
+	if ( !failsafe )
+	{
+		printf( "%s: no failsafe without frames\n" , PROTOCOL );
+		errors++;
+	}
+	send_golden( &golden[0] , 3000000 / FRAME_US );
+	errors += check_golden( &golden[0] , "after failsafe" );
+
+	bench( 100000 );
+
+	printf( "%s: %d golden frames, %d fuzz iterations, %d errors\n" , PROTOCOL , GOLDEN_COUNT , iterations , errors );
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,9 @@
+// config.h override for the rx decoder tests ( rxtest.c )
+// the protocol comes from the command line, RX_SBUS, RX_BAYANG_PROTOCOL, ...
+// RXTEST_BLE_APP keeps the RX_BAYANG_BLE_APP of config.h
+#ifndef RXTEST_BLE_APP
+#undef RX_BAYANG_BLE_APP
+#endif
+// the drivers time the bytes with gettime(), not with SysTick
+#undef TIMEBASE_TIM2
+#define TIMEBASE_TIM2
@@ -0,0 +1,135 @@
+// xn297 radio for the rx decoder tests ( rxtest.c )
+// takes the place of the soft spi ( drv_spi.c ), below the unchanged drv_xn297.c / drv_xn297_3wire.c
+// registers, the pipe 0 rx address, a 3 packet rx fifo and the last tx payload
+// a packet in the air reaches the fifo only in rx mode, on the set channel, address and payload size
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "xn297.h"
+
+#define PAYLOAD_MAX 32
+#define FIFO_DEPTH 3
+
+// power on values, the rx checks pipe 5 ( RADIO_CHECK )
+static uint8_t reg[32] = { [RX_ADDR_P5] = 0xc6 };
+static uint8_t rxaddress[5] = { 0xe7 , 0xe7 , 0xe7 , 0xe7 , 0xe7 };
+static uint8_t fifo[FIFO_DEPTH][PAYLOAD_MAX];
+static int fifo_count;
+
+static int command;
+static int position;
+
+// last payload sent by the rx ( telemetry, beacons )
+uint8_t xn297_txdata[PAYLOAD_MAX];
+int xn297_txcount;
+
+static int status( void)
+{
+	// RX_P_NO 111 when the rx fifo is empty
+	return fifo_count ? ( 1 << RX_DR ) : 7 << RX_P_NO;
+}
+
+static int readreg( int r )
+{
+	if ( r == STATUS ) return status();
+	if ( r == FIFO_STATUS )
+	{
+		// tx always done, the payload leaves as it is written
+		return ( 1 << TX_EMPTY ) | ( fifo_count ? 0 : 1 << RX_EMPTY ) | ( fifo_count == FIFO_DEPTH ? 1 << RX_FULL : 0 );
+	}
+	return reg[r];
+}
+
+static int transfer( int data )
+{
+	data &= 0xff;
+
+	if ( position == 0 )
+	{
+		command = data;
+		position = 1;
+		if ( command == FLUSH_RX ) fifo_count = 0;
+		return status();
+	}
+
+	int index = position - 1;
+	position++;
+
+	if ( command < W_REGISTER ) return readreg( command & REGISTER_MASK );
+
+	if ( command < ACTIVATE )
+	{
+		int r = command & REGISTER_MASK;
+		if ( r == RX_ADDR_P0 )
+		{
+			if ( index < 5 ) rxaddress[index] = data;
+		}
+		// other multi byte registers ( tx address, calibration ) keep the first byte only
+		else if ( index == 0 ) reg[r] = data;
+		return 0;
+	}
+
+	if ( command == R_RX_PAYLOAD )
+		return fifo_count && index < PAYLOAD_MAX ? fifo[0][index] : 0;
+
+	if ( command == W_TX_PAYLOAD && index < PAYLOAD_MAX ) xn297_txdata[index] = data;
+
+	return 0;
+}
+
+void spi_cson( void)
+{
+	position = 0;
+}
+
+void spi_csoff( void)
+{
+	if ( position > 1 && command == R_RX_PAYLOAD && fifo_count )
+	{
+		fifo_count--;
+		memmove( fifo[0] , fifo[1] , fifo_count * PAYLOAD_MAX );
+	}
+	if ( position > 1 && command == W_TX_PAYLOAD ) xn297_txcount++;
+	position = 0;
+}
+
+void spi_sendbyte( int data )
+{
+	transfer( data );
+}
+
+int spi_sendrecvbyte( int data )
+{
+	return transfer( data );
+}
+
+int spi_sendzerorecvbyte( void)
+{
+	return transfer( 0 );
+}
+
+// 3 wire spi, the data pin turns around for the read
+void mosi_input( void) {}
+
+int spi_recvbyte( void)
+{
+	return transfer( 0 );
+}
+
+void spi_init( void) {}
+
+// a packet from the transmitter
+void xn297_air( const uint8_t * payload , int size , int channel , const uint8_t address[5] )
+{
+	// powered up in rx mode
+	if ( ( reg[CONFIG] & ( 1 << PWR_UP | 1 << PRIM_RX ) ) != ( 1 << PWR_UP | 1 << PRIM_RX ) ) return;
+	if ( ( reg[RF_CH] & 0x7f ) != channel ) return;
+	if ( memcmp( address , rxaddress , 5 ) ) return;
+	// a different payload size fails the crc
+	if ( size != reg[RX_PW_P0] || size > PAYLOAD_MAX ) return;
+	if ( fifo_count == FIFO_DEPTH ) return;
+	memset( fifo[fifo_count] , 0 , PAYLOAD_MAX );
+	memcpy( fifo[fifo_count] , payload , size );
+	fifo_count++;
+}
@@ -0,0 +1,169 @@
+"""
+Filter and PID settings sweep over a recorded trace.
+
+Every variant is built as its own replay binary and run over the trace,
+all cores in parallel. The results are ranked by gyro filter delay and
+noise attenuation, with the pid output noise as a tie breaker.
+
+    python sweep.py trace.csv variants.txt
+    python sweep.py trace.csv variants.txt --signal 40 --noise 250 --jobs 8
+
+variants.txt, one variant per line, "#" starts a comment:
+
+    stock
+    pt1_80    !KALMAN_GYRO PT1_GYRO GYRO_FILTER_PASS1=HZ_80 DTERM_LPF_2ND_HZ=90
+    d_low     DTERM_LPF_2ND_HZ=70 MOTOR_FILTER2_ALPHA=MFILT1_HZ_70
+    kd_up     pidkd=0.9,0.9,0.55
+
+NAME=VALUE and NAME replace the config.h defines of that name, !NAME removes it,
+pidkp= pidki= pidkd= set the pid arrays at run time.
+The trace format is described in replay.c.
+
+The replay has no model of the quad, so the gyro in the trace does not
+react to the settings. There is no step response, only the filters and
+the controller output are compared.
+"""
+import argparse
+import cmath
+import math
+import os
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+GYRO_SCALE = 0.061035156 * 0.017453292    # sensor units to rad/s
+
+
+def read_csv(path):
+    rows = []
+    with open(path) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            rows.append([float(x) for x in line.replace(",", " ").split()])
+    return rows
+
+
+def read_variants(path):
+    variants = []
+    with open(path) as f:
+        for line in f:
+            words = line.split("#")[0].split()
+            if not words:
+                continue
+            defines, pids = [], []
+            for word in words[1:]:
+                if word.startswith(("pidkp=", "pidki=", "pidkd=")):
+                    pids.append(word)
+                else:
+                    name, _, value = word.partition("=")
+                    defines.append((name, value))
+            variants.append((words[0], defines, pids))
+    return variants
+
+
+def dft(x, f, fs):
+    """Single frequency dft with a hann window."""
+    n = len(x)
+    w = -2j * math.pi * f / fs
+    total = 0
+    for i, v in enumerate(x):
+        total += v * (0.5 - 0.5 * math.cos(2 * math.pi * i / (n - 1))) * cmath.exp(w * i)
+    return total
+
+
+def response(raw, filtered, f, fs):
+    """Gain in dB and delay in ms of the filter at f, roll and pitch averaged."""
+    gains, delays = [], []
+    for axis in (0, 1):
+        x = dft([r * GYRO_SCALE for r in raw[axis]], f, fs)
+        y = dft(filtered[axis], f, fs)
+        if abs(x) == 0:
+            continue
+        h = y / x
+        gains.append(20 * math.log10(max(abs(h), 1e-9)))
+        delays.append(-cmath.phase(h) / (2 * math.pi * f) * 1000)
+    if not gains:
+        return float("nan"), float("nan")
+    return sum(gains) / len(gains), sum(delays) / len(delays)
+
+
+def run(variant, trace, workdir):
+    name, defines, pids = variant
+    out = os.path.join(workdir, name)
+    os.makedirs(out, exist_ok=True)
+
+    header = os.path.join(out, "override.h")
+    with open(header, "w") as f:
+        for define, value in defines:
+            if define.startswith("!"):
+                f.write("#undef %s\n" % define[1:])
+            else:
+                f.write("#undef %s\n#define %s %s\n" % (define, define, value))
+
+    build = subprocess.run(["make", "-s", "-C", HERE, "OUT=" + out, "OVERRIDE=" + header],
+                           stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if build.returncode:
+        errors = [line for line in build.stdout.splitlines() if "error" in line]
+        return name, None, errors[:1]
+
+    command = [os.path.join(out, "replay")]
+    for p in pids:
+        command += ["-p", p]
+    result = os.path.join(out, "out.csv")
+    replay = subprocess.run(command + [trace, result],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if replay.returncode:
+        return name, None, replay.stdout.strip().splitlines()[-1:]
+    return name, read_csv(result), None
+
+
+def rms_diff(values):
+    d = [b - a for a, b in zip(values, values[1:])]
+    return math.sqrt(sum(x * x for x in d) / max(len(d), 1))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace")
+    parser.add_argument("variants")
+    parser.add_argument("--signal", type=float, default=50, help="frequency for the delay, Hz")
+    parser.add_argument("--noise", type=float, default=200, help="frequency for the attenuation, Hz")
+    parser.add_argument("--weight", type=float, default=10, help="dB of attenuation worth 1 ms of delay")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count())
+    args = parser.parse_args()
+
+    trace = read_csv(args.trace)
+    if len(trace) < 2:
+        sys.exit("trace too short")
+    fs = 1e6 * (len(trace) - 1) / (trace[-1][0] - trace[0][0])
+    raw = [[row[1 + axis] for row in trace] for axis in range(3)]
+
+    variants = read_variants(args.variants)
+    workdir = tempfile.mkdtemp(prefix="sweep")
+    with ThreadPoolExecutor(args.jobs) as pool:
+        results = list(pool.map(lambda v: run(v, os.path.abspath(args.trace), workdir), variants))
+
+    table = []
+    for name, rows, error in results:
+        if rows is None:
+            print("%s failed: %s" % (name, " ".join(error)))
+            continue
+        filtered = [[row[8 + axis] for row in rows] for axis in range(3)]
+        _, delay = response(raw, filtered, args.signal, fs)
+        gain, _ = response(raw, filtered, args.noise, fs)
+        noise = sum(rms_diff([row[1 + axis] for row in rows]) for axis in range(3)) / 3
+        table.append((gain + args.weight * delay, name, delay, gain, noise))
+
+    table.sort(key=lambda t: (t[0], t[4]))
+    print("%-16s %10s %12s %10s %10s" % ("variant", "score", "delay ms", "gain dB", "pid noise"))
+    print("%-16s %10s %12s %10s %10s" % ("", "", "@%g Hz" % args.signal, "@%g Hz" % args.noise, ""))
+    for score, name, delay, gain, noise in table:
+        print("%-16s %10.2f %12.3f %10.2f %10.5f" % (name, score, delay, gain, noise))
+    print("builds in %s" % workdir)
+
+
+if __name__ == "__main__":
+    main()
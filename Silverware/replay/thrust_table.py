@@ -0,0 +1,106 @@
+"""
+Motor thrust table for MOTOR_CURVE_TABLE from thrust stand measurements.
+
+    python thrust_table.py motors.csv > ../src/motor_table.h
+    python thrust_table.py bl.csv fr.csv br.csv fl.csv --size 17 > ../src/motor_table.h
+
+One csv gives one table for all motors. Four give one table per motor,
+in motor number order ( MOTOR_BL 0, MOTOR_FL 1, MOTOR_BR 2, MOTOR_FR 3 in defines.h ).
+
+csv, one measurement per line, "#" starts a comment:
+
+    pwm, thrust[, voltage]
+
+pwm from 0 to 1, thrust in any unit, voltage of the battery during the
+measurement. With per motor tables, full thrust is that of the weakest
+motor, so the stronger ones never get full pwm and all motors match.
+With a voltage column the mean voltage goes into the table, and the
+firmware scales the pwm by that voltage over vbattfilt.
+"""
+import argparse
+import sys
+
+
+def read_csv(path):
+    rows = []
+    with open(path) as f:
+        for line in f:
+            line = line.split("#")[0].strip()
+            if not line:
+                continue
+            try:
+                rows.append([float(x) for x in line.replace(",", " ").split()])
+            except ValueError:
+                continue    # header line
+    if len(rows) < 2:
+        sys.exit("%s: not enough measurements" % path)
+    rows.sort()
+    return rows
+
+
+def invert(rows, size, full):
+    """pwm for evenly spaced thrust from 0 to full, linear between measurements."""
+    pwm = [r[0] for r in rows]
+    thrust = []
+    for r in rows:
+        # thrust must not fall with more pwm
+        thrust.append(max(r[1], thrust[-1] if thrust else r[1]))
+
+    table = []
+    for k in range(size):
+        target = full * k / (size - 1)
+        if target <= thrust[0]:
+            table.append(pwm[0] if target > 0 or thrust[0] <= 0 else 0.0)
+            continue
+        for i in range(1, len(thrust)):
+            if thrust[i] >= target:
+                span = thrust[i] - thrust[i - 1]
+                f = (target - thrust[i - 1]) / span if span > 0 else 0
+                table.append(pwm[i - 1] + f * (pwm[i] - pwm[i - 1]))
+                break
+        else:
+            table.append(pwm[-1])
+    return [min(max(p, 0.0), 1.0) for p in table]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("csv", nargs="+")
+    parser.add_argument("--size", type=int, default=17, help="points per table")
+    args = parser.parse_args()
+
+    if len(args.csv) not in (1, 4):
+        sys.exit("one csv for all motors or four, one per motor")
+    if args.size < 2:
+        sys.exit("size must be 2 or more")
+
+    motors = [read_csv(path) for path in args.csv]
+    full = min(max(r[1] for r in rows) for rows in motors)
+    tables = [invert(rows, args.size, full) for rows in motors]
+
+    volts = [r[2] for rows in motors for r in rows if len(r) > 2]
+
+    print("// motor thrust table for MOTOR_CURVE_TABLE")
+    print("// made by replay/thrust_table.py from %s" % " ".join(args.csv))
+    print("")
+    print("// number of tables, 1 for all motors or 4, one per motor number")
+    print("#define MOTOR_TABLE_COUNT %d" % len(tables))
+    print("// points per table, evenly spaced thrust from 0 to 1")
+    print("#define MOTOR_TABLE_SIZE %d" % args.size)
+    print("// battery voltage during the measurement, the output is scaled with it")
+    if volts:
+        print("#define MOTOR_TABLE_VOLTAGE %.2f" % (sum(volts) / len(volts)))
+    else:
+        print("//#define MOTOR_TABLE_VOLTAGE 4.00")
+    print("")
+    print("static const float motor_table[MOTOR_TABLE_COUNT][MOTOR_TABLE_SIZE] =")
+    print("{")
+    for table in tables:
+        values = ["%.4ff" % p for p in table]
+        lines = [" , ".join(values[i:i + 9]) for i in range(0, len(values), 9)]
+        print("\t{ " + " ,\n\t  ".join(lines) + " },")
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
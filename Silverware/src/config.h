@@ -358,6 +358,10 @@ Adjust pids in @ref pid.c file for any non whoop builds.
 ///PWM frequency for motor control. A higher frequency makes the motors more linear (in Hz).
 #define PWMFREQ 32000
 
+// *************carry the part of a pwm step lost to rounding into the next loop, more resolution at high PWMFREQ
+// *************also allows PWMFREQ up to about twice the normal limit
+//#define PWM_DITHER
+
 // *************clip feedforward attempts to resolve issues that occur near full throttle by adding any clipped motor commands to the next loop output
 //#define CLIP_FF
 
@@ -429,6 +433,32 @@ Adjust pids in @ref pid.c file for any non whoop builds.
 //#define INVERTED_ENABLE
 //#define FN_INVERTED CH_OFF //for brushless only
 
+/// Fast boot for battery swaps.
+/// Starts from the gyro bias and gravity vector saved in flash and checks them
+/// with a short still window instead of the full 2 second gyro calibration.
+/// The bias keeps refining on the ground until takeoff. Radio init overlaps the gyro power up.
+/// Requires FLASH_SAVE1, saved on first boot and with the **DDD** gesture.
+/// With ARMING the refined bias is also saved at disarm on the ground if it moved.
+//#define FAST_BOOT
+
+/// Keep estimating the gyro bias whenever the quad is still on the ground.
+/// Also shortens the power up calibration to 1 second.
+//#define GYRO_BIAS_TRACKING
+
+/// With GYRO_BIAS_TRACKING: learn the bias change per degree of gyro temperature
+/// on the ground and follow the temperature in flight.
+//#define GYRO_BIAS_TEMP
+
+/// Queue the gyro samples in the gyro fifo and average all of them each loop,
+/// less motor noise aliased into the pid band. Needs GYRO_LOW_PASS_FILTER 0 or 7 ( 8khz gyro rate ).
+/// Fifo rate 8khz / ( GYRO_FIFO_RATE_DIV + 1 ), default 4khz on i2c and 8khz on spi.
+/// On i2c that is 34 bytes a loop instead of 14, about 400 bus clocks with the headers:
+/// 0.4ms at 1Mhz, 1ms at 400khz. Needs HW_I2C_SPEED_FAST2 / FAST_OC / AUTO or the soft i2c
+/// FAST / SLOW1 / AUTO speeds ( about 2.4 and 1.1Mhz from the instruction counts ).
+/// The AUTO speeds can still step down below 800khz on bus errors.
+//#define GYRO_FIFO
+//#define GYRO_FIFO_RATE_DIV 1
+
 /// Special test mode to check transmitter stick throws
 /// This define will allow you to check if your radio is reaching 100% throws.
 /// - Entering **RRD** gesture will disable throttle and will rapid blink the led 
@@ -512,6 +542,11 @@ Adjust pids in @ref pid.c file for any non whoop builds.
 	#endif
 #endif
 
+// filter settings from the pc tools ( replay/sweep.py ), never set in a firmware build
+#ifdef CONFIG_OVERRIDE
+#include CONFIG_OVERRIDE
+#endif
+
 #define GYRO_LOW_PASS_FILTER 0
 
 #define DISABLE_FLIP_SEQUENCER
@@ -529,6 +564,8 @@ Adjust pids in @ref pid.c file for any non whoop builds.
 // *************motor curve to use - select one
 // *************the pwm frequency has to be set independently
 #define MOTOR_CURVE_NONE
+// *************measured thrust table(s) in motor_table.h, made by replay/thrust_table.py
+//#define MOTOR_CURVE_TABLE
 
 // loop time in uS
 // this affects soft gyro lpf frequency if used
@@ -543,6 +580,40 @@ Adjust pids in @ref pid.c file for any non whoop builds.
 // rxdebug structure
 //#define RXDEBUG
 
+// serial tx on the SWCLK pin (PA14), 115200 baud
+// disables programming after gyro calibration
+//#define SERIAL_ENABLE
+
+// LTM telemetry frames on the serial tx for an OSD
+//#define OSD_LTM_PROTOCOL
+
+// raw gyro capture on the serial tx, for gyro_psd.py
+// starts when the channel goes on, CHAN_6 on toy tx = RRD/LLD gesture
+//#define GYRO_CAPTURE CHAN_OFF
+// captured data: 1 roll, 2 pitch, 4 yaw, 8 motors ( 16 bit each )
+#define GYRO_CAPTURE_AXES 7
+
+// onboard gyro noise analyzer, strongest vibration peak per axis
+// sent in the bayang telemetry ( bytes 8 - 13 ) and the debug struct
+//#define NOISE_ANALYZER
+
+// interrupt timing, longest interrupts off window per driver, handler run times and latency
+// results in irq_timing, the debug struct and the bayang telemetry ( bytes 8 - 10 )
+//#define IRQ_TIMING
+
+// on a hard fault, loop overrun, i2c or led dma error write the last loop stages and state to flash
+// before the failloop blinks, decode with fault_decode.py
+//#define FAULT_RECORD
+
+// stack high water mark, free stack in the debug struct and the bayang telemetry ( byte 2 )
+// static ram per source file with "make ramreport" in the gcc folder
+//#define STACK_CHECK
+
+// run pid and the gyro filters from ram, no flash wait states ( gcc build only )
+// uses some ram, check with "make ramreport" in the gcc folder
+// "make RAMFLOAT=1" also moves the libgcc float add, sub and mul they call
+//#define RAM_HOT_PATH
+
 // enable motors if pitch / roll controls off center (at zero throttle)
 // possible values: 0 / 1
 // use in acro build only
@@ -554,6 +625,10 @@ Adjust pids in @ref pid.c file for any non whoop builds.
 
 #define ENABLE_OVERCLOCK
 
+// 32 bit TIM2 as the 1 MHz time base instead of SysTick
+// STM32F031 only, the F030 has no TIM2 ( gcc builds use the f031 startup file )
+//#define TIMEBASE_TIM2
+
 #pragma diag_warning 1035 , 177 , 4017
 #pragma diag_error 260
 
@@ -569,6 +644,75 @@ Adjust pids in @ref pid.c file for any non whoop builds.
 #define SYS_CLOCK_FREQ_HZ 48000000
 #endif
 
+// TIM2 is a motor timer on these pins
+#if defined(TIMEBASE_TIM2) && ( defined(PWM_PA0) || defined(PWM_PA1) || defined(PWM_PA2) || defined(PWM_PA3) || defined(PWM_PA5) )
+#warning "TIMEBASE_TIM2 not possible, a motor pin uses TIM2"
+#undef TIMEBASE_TIM2
+#endif
+
+// functions placed in the .ramfunc section, copied to ram with .data at startup
+// calls between flash and ram go through linker generated long branch stubs
+#if defined(RAM_HOT_PATH) && defined(__GNUC__) && !defined(__CC_ARM)
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+#if defined(GYRO_CAPTURE) && !defined(SERIAL_ENABLE)
+#define SERIAL_ENABLE
+#endif
+
+#if defined(OSD_LTM_PROTOCOL) && !defined(SERIAL_ENABLE)
+#define SERIAL_ENABLE
+#endif
+
+// getcycles() is only safe in interrupts with the TIM2 time base
+#if defined(IRQ_TIMING) && !defined(TIMEBASE_TIM2)
+#warning "IRQ_TIMING needs the TIM2 time base"
+#undef IRQ_TIMING
+#endif
+
+// the spi gyro is read through its fifo
+#if defined(USE_SPI_GYRO) && !defined(GYRO_FIFO)
+#define GYRO_FIFO
+#endif
+
+#ifdef GYRO_FIFO
+#if GYRO_LOW_PASS_FILTER != 0 && GYRO_LOW_PASS_FILTER != 7
+#error "GYRO_FIFO: set GYRO_LOW_PASS_FILTER 0 or 7, the fifo needs the 8khz gyro rate"
+#endif
+// the fifo reads need about 800khz on i2c ( see GYRO_FIFO above )
+#if !defined(USE_SPI_GYRO) && ( ( defined(USE_SOFTWARE_I2C) && defined(SOFTI2C_SPEED_SLOW2) ) || \
+    ( defined(USE_HARDWARE_I2C) && !defined(HW_I2C_SPEED_FAST2) && !defined(HW_I2C_SPEED_FAST_OC) && !defined(HW_I2C_SPEED_AUTO) ) )
+#error "GYRO_FIFO: i2c speed too slow for the fifo reads, use a 1Mhz or faster speed"
+#endif
+#endif
+
+#ifdef USE_SPI_GYRO
+#if SPI_GYRO_MOSI_PA < 0 || SPI_GYRO_MISO_PA < 0 || SPI_GYRO_CLK_PA < 0 || SPI_GYRO_SS_PA < 0
+#error "USE_SPI_GYRO: set the spi gyro pins in hardware.h"
+#endif
+#define SPI_GYRO_USES( n ) ( SPI_GYRO_MOSI_PA == n || SPI_GYRO_MISO_PA == n || SPI_GYRO_CLK_PA == n || SPI_GYRO_SS_PA == n )
+#if ( defined(PWM_PA0) && SPI_GYRO_USES(0) ) || ( defined(PWM_PA1) && SPI_GYRO_USES(1) ) || \
+    ( defined(PWM_PA2) && SPI_GYRO_USES(2) ) || ( defined(PWM_PA3) && SPI_GYRO_USES(3) ) || \
+    ( defined(PWM_PA4) && SPI_GYRO_USES(4) ) || ( defined(PWM_PA5) && SPI_GYRO_USES(5) ) || \
+    ( defined(PWM_PA6) && SPI_GYRO_USES(6) ) || ( defined(PWM_PA7) && SPI_GYRO_USES(7) ) || \
+    ( defined(PWM_PA8) && SPI_GYRO_USES(8) ) || ( defined(PWM_PA9) && SPI_GYRO_USES(9) ) || \
+    ( defined(PWM_PA10) && SPI_GYRO_USES(10) ) || ( defined(PWM_PA11) && SPI_GYRO_USES(11) )
+#error "USE_SPI_GYRO: a spi gyro pin is also a motor pin"
+#endif
+// programming pins, also the serial rx and 4way pins
+#if SPI_GYRO_USES(13) || SPI_GYRO_USES(14)
+#error "USE_SPI_GYRO: PA13 / PA14 are the swd pins"
+#endif
+// radio, led and rgb pins are cast expressions, checked in drv_spi_gyro.c
+#endif
+
+#if defined(FAST_BOOT) && !defined(FLASH_SAVE1)
+#warning "FAST_BOOT needs FLASH_SAVE1"
+#undef FAST_BOOT
+#endif
+
 #ifdef MOTOR_BEEPS
 #ifdef USE_ESC_DRIVER
 #warning "MOTOR BEEPS_WORKS WITH BRUSHED MOTORS ONLY"
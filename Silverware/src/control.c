@@ -72,7 +72,8 @@ int onground_long = 1;
 float thrsum;
 
 float error[PIDNUMBER];
-float motormap( float input);
+float motormap( float input , int motor );
+void capture_motor( int motor , float value );
 
 float yawangle;
 
@@ -106,6 +107,15 @@ extern int acro_override;
 float overthrottlefilt = 0;
 float underthrottlefilt = 0;
 
+// roll, pitch and yaw share of each motor, throttle is the same for all
+static const float motor_mix[4][3] =
+{
+	[MOTOR_FR] = { -1.0f , -1.0f ,  1.0f },
+	[MOTOR_FL] = {  1.0f , -1.0f , -1.0f },
+	[MOTOR_BR] = { -1.0f ,  1.0f , -1.0f },
+	[MOTOR_BL] = {  1.0f ,  1.0f ,  1.0f },
+};
+
 float rxcopy[4];
 
 
@@ -150,6 +160,182 @@ static float calcBFRatesRad(int axis)
 #endif
 
 
+// airmode desaturation from the largest and smallest motor mix
+// returns the amount to take off every motor, the options run in order
+// and each one sees the mix as left by the ones before
+static float mix_desaturate( float mixmax , float mixmin )
+{
+	float mixshift = 0.0f;
+
+#if ( defined MIX_LOWER_THROTTLE || defined MIX_INCREASE_THROTTLE)
+
+//#define MIX_INCREASE_THROTTLE
+
+// options for mix throttle lowering if enabled
+// 0 - 100 range ( 100 = full reduction / 0 = no reduction )
+#ifndef MIX_THROTTLE_REDUCTION_PERCENT
+#define MIX_THROTTLE_REDUCTION_PERCENT 100
+#endif
+// lpf (exponential) shape if on, othewise linear
+//#define MIX_THROTTLE_FILTER_LPF
+
+// limit reduction and increase to this amount ( 0.0 - 1.0)
+// 0.0 = no action 
+// 0.5 = reduce up to 1/2 throttle      
+//1.0 = reduce all the way to zero 
+#ifndef MIX_THROTTLE_REDUCTION_MAX
+#define MIX_THROTTLE_REDUCTION_MAX 0.5
+#endif
+
+#ifndef MIX_MOTOR_MAX
+#define MIX_MOTOR_MAX 1.0f
+#endif
+
+
+		  float overthrottle = 0;
+		  float underthrottle = 0.001f;
+		
+		  if (mixmax > overthrottle)
+			  overthrottle = mixmax;
+		  if (mixmin < underthrottle)
+			  underthrottle = mixmin;
+
+#ifdef MIX_LOWER_THROTTLE
+            
+		  overthrottle -= MIX_MOTOR_MAX ;
+
+		  if (overthrottle > (float)MIX_THROTTLE_REDUCTION_MAX)
+			  overthrottle = (float)MIX_THROTTLE_REDUCTION_MAX;
+
+#ifdef MIX_THROTTLE_FILTER_LPF
+		  if (overthrottle > overthrottlefilt)
+			  lpf(&overthrottlefilt, overthrottle, 0.82);	// 20hz 1khz sample rate
+		  else
+			  lpf(&overthrottlefilt, overthrottle, 0.72);	// 50hz 1khz sample rate
+#else
+		  if (overthrottle > overthrottlefilt)
+			  overthrottlefilt += 0.005f;
+		  else
+			  overthrottlefilt -= 0.01f;
+#endif
+#else
+overthrottle = 0.0f;        
+#endif
+          
+#ifdef MIX_INCREASE_THROTTLE
+// under			
+			
+		  if (underthrottle < -(float)MIX_THROTTLE_REDUCTION_MAX)
+			  underthrottle = -(float)MIX_THROTTLE_REDUCTION_MAX;
+			
+#ifdef MIX_THROTTLE_FILTER_LPF
+		  if (underthrottle < underthrottlefilt)
+			  lpf(&underthrottlefilt, underthrottle, 0.82);	// 20hz 1khz sample rate
+		  else
+			  lpf(&underthrottlefilt, underthrottle, 0.72);	// 50hz 1khz sample rate
+#else
+		  if (underthrottle < underthrottlefilt)
+			  underthrottlefilt -= 0.005f;
+		  else
+			  underthrottlefilt += 0.01f;
+#endif
+// under
+			if (underthrottlefilt < - (float)MIX_THROTTLE_REDUCTION_MAX)
+			  underthrottlefilt = - (float)MIX_THROTTLE_REDUCTION_MAX;
+		  if (underthrottlefilt > 0.1f)
+			  underthrottlefilt = 0.1;
+
+			underthrottle = underthrottlefilt;
+					
+			if (underthrottle > 0.0f)
+			  underthrottle = 0.0001f;
+
+			underthrottle *= ((float)MIX_THROTTLE_REDUCTION_PERCENT / 100.0f);
+#else
+  underthrottle = 0.001f;			
+#endif			
+// over			
+		  if (overthrottlefilt > (float)MIX_THROTTLE_REDUCTION_MAX)
+			  overthrottlefilt = (float)MIX_THROTTLE_REDUCTION_MAX;
+		  if (overthrottlefilt < -0.1f)
+			  overthrottlefilt = -0.1;
+
+
+		  overthrottle = overthrottlefilt;
+
+			
+		  if (overthrottle < 0.0f)
+			  overthrottle = -0.0001f;
+
+			
+			// reduce by a percentage only, so we get an inbetween performance
+			overthrottle *= ((float)MIX_THROTTLE_REDUCTION_PERCENT / 100.0f);
+
+			
+			
+		  if (overthrottle > 0 || underthrottle < 0 )
+		    {		// exceeding max motor thrust
+					mixshift = overthrottle + underthrottle;
+		    }
+#endif				
+
+
+#ifdef MIX_LOWER_THROTTLE_3
+{
+#ifndef MIX_THROTTLE_REDUCTION_MAX
+#define MIX_THROTTLE_REDUCTION_MAX 0.5f
+#endif
+
+float overthrottle = 0;
+
+if ( mixmax - mixshift > overthrottle )
+    overthrottle = mixmax - mixshift;
+
+
+overthrottle -=1.0f;
+// limit to half throttle max reduction
+if ( overthrottle > (float) MIX_THROTTLE_REDUCTION_MAX)  overthrottle = (float) MIX_THROTTLE_REDUCTION_MAX;
+
+if ( overthrottle > 0.0f)
+    mixshift += overthrottle;
+#ifdef MIX_THROTTLE_FLASHLED
+if ( overthrottle > 0.1f) ledcommand = 1;
+#endif
+}
+#endif
+
+
+#ifdef MIX_INCREASE_THROTTLE_3
+{
+#ifndef MIX_THROTTLE_INCREASE_MAX
+#define MIX_THROTTLE_INCREASE_MAX 0.2f
+#endif
+	if (in_air == 1){
+		float underthrottle = 0;
+
+		if ( mixmin - mixshift < underthrottle )
+			underthrottle = mixmin - mixshift;
+
+
+		// limit to half throttle max reduction
+		if ( underthrottle < -(float) MIX_THROTTLE_INCREASE_MAX)  underthrottle = -(float) MIX_THROTTLE_INCREASE_MAX;
+
+		if ( underthrottle < 0.0f)
+			mixshift += underthrottle;
+		#ifdef MIX_THROTTLE_FLASHLED
+			if ( underthrottle < -0.01f) ledcommand = 1;
+		#endif
+	}
+}
+#endif
+
+            
+            
+
+	return mixshift;
+}
+
+
 /**
 Flight control
 
@@ -378,20 +564,10 @@ if (aux[LEVELMODE]&&!acro_override){
 
 
  #ifdef YAW_FIX
-{	
 	rotateErrors();
-	pid(0);
-	pid(1);
-	pid(2);		}
- #else 	
-{
-  pid(0);
-	pid(1);
-	pid(2);	
-
-}
+ #endif
 
-#endif
+	pid();
 
 
 #ifndef THROTTLE_SAFETY
@@ -636,44 +812,21 @@ extern float throttlehpf( float in );
 	#endif
 #endif
 	
+		// motor mix, all pid signs flip for inverted flight
+		float pidsign = 1.0f;
 #ifdef INVERTED_ENABLE
-if (pwmdir == REVERSE)
-		{
-			// inverted flight
-		
-		mix[MOTOR_FR] = throttle + pidoutput[ROLL] + pidoutput[PITCH] - pidoutput[YAW];		// FR
-		mix[MOTOR_FL] = throttle - pidoutput[ROLL] + pidoutput[PITCH] + pidoutput[YAW];		// FL	
-		mix[MOTOR_BR] = throttle + pidoutput[ROLL] - pidoutput[PITCH] + pidoutput[YAW];		// BR
-		mix[MOTOR_BL] = throttle - pidoutput[ROLL] - pidoutput[PITCH] - pidoutput[YAW];		// BL	
-		
-
-		}	
-else
-#endif    
-{
-    // normal mixer
-		mix[MOTOR_FR] = throttle - pidoutput[ROLL] - pidoutput[PITCH] + pidoutput[YAW];		// FR
-		mix[MOTOR_FL] = throttle + pidoutput[ROLL] - pidoutput[PITCH] - pidoutput[YAW];		// FL	
-		mix[MOTOR_BR] = throttle - pidoutput[ROLL] + pidoutput[PITCH] - pidoutput[YAW];		// BR
-		mix[MOTOR_BL] = throttle + pidoutput[ROLL] + pidoutput[PITCH] + pidoutput[YAW];		// BL	
-}
-
-#ifdef INVERT_YAW_PID
-// we invert again cause it's used by the pid internally (for limit)
-	#ifdef SWITCHABLE_FEATURE_3
-	extern int flash_feature_3;
-		if (flash_feature_3 == 0){
-			pidoutput[2] = -pidoutput[2];
-		}else{
-			//do nothing
-		}
-	#else
-		pidoutput[2] = -pidoutput[2];
-	#endif		
+		if (pwmdir == REVERSE) pidsign = -1.0f;
 #endif
+		float mixroll = pidsign * pidoutput[ROLL];
+		float mixpitch = pidsign * pidoutput[PITCH];
+		float mixyaw = pidsign * pidoutput[YAW];
+		float mixmax = 0.0f;
+		float mixmin = 0.0f;
 
 		for ( int i = 0 ; i <= 3 ; i++)
-		{			
+		{
+		mix[i] = throttle + motor_mix[i][ROLL] * mixroll + motor_mix[i][PITCH] * mixpitch + motor_mix[i][YAW] * mixyaw;
+
 		#ifdef MOTOR_FILTER		
 		mix[i] = motorfilter(  mix[i] , i);
 		#endif	
@@ -692,197 +845,33 @@ else
        		float motord( float in , int x);           
 		mix[i] = motord(  mix[i] , i);
 		#endif
-       		}
-
-
-#if ( defined MIX_LOWER_THROTTLE || defined MIX_INCREASE_THROTTLE)
-
-//#define MIX_INCREASE_THROTTLE
-
-// options for mix throttle lowering if enabled
-// 0 - 100 range ( 100 = full reduction / 0 = no reduction )
-#ifndef MIX_THROTTLE_REDUCTION_PERCENT
-#define MIX_THROTTLE_REDUCTION_PERCENT 100
-#endif
-// lpf (exponential) shape if on, othewise linear
-//#define MIX_THROTTLE_FILTER_LPF
-
-// limit reduction and increase to this amount ( 0.0 - 1.0)
-// 0.0 = no action 
-// 0.5 = reduce up to 1/2 throttle      
-//1.0 = reduce all the way to zero 
-#ifndef MIX_THROTTLE_REDUCTION_MAX
-#define MIX_THROTTLE_REDUCTION_MAX 0.5
-#endif
-
-#ifndef MIX_MOTOR_MAX
-#define MIX_MOTOR_MAX 1.0f
-#endif
-
-
-		  float overthrottle = 0;
-		  float underthrottle = 0.001f;
-		
-		  for (int i = 0; i < 4; i++)
-		    {
-			    if (mix[i] > overthrottle)
-				    overthrottle = mix[i];
-					if (mix[i] < underthrottle)
-						underthrottle = mix[i];
-		    }
-
-#ifdef MIX_LOWER_THROTTLE
-            
-		  overthrottle -= MIX_MOTOR_MAX ;
-
-		  if (overthrottle > (float)MIX_THROTTLE_REDUCTION_MAX)
-			  overthrottle = (float)MIX_THROTTLE_REDUCTION_MAX;
-
-#ifdef MIX_THROTTLE_FILTER_LPF
-		  if (overthrottle > overthrottlefilt)
-			  lpf(&overthrottlefilt, overthrottle, 0.82);	// 20hz 1khz sample rate
-		  else
-			  lpf(&overthrottlefilt, overthrottle, 0.72);	// 50hz 1khz sample rate
-#else
-		  if (overthrottle > overthrottlefilt)
-			  overthrottlefilt += 0.005f;
-		  else
-			  overthrottlefilt -= 0.01f;
-#endif
-#else
-overthrottle = 0.0f;        
-#endif
-          
-#ifdef MIX_INCREASE_THROTTLE
-// under			
-			
-		  if (underthrottle < -(float)MIX_THROTTLE_REDUCTION_MAX)
-			  underthrottle = -(float)MIX_THROTTLE_REDUCTION_MAX;
-			
-#ifdef MIX_THROTTLE_FILTER_LPF
-		  if (underthrottle < underthrottlefilt)
-			  lpf(&underthrottlefilt, underthrottle, 0.82);	// 20hz 1khz sample rate
-		  else
-			  lpf(&underthrottlefilt, underthrottle, 0.72);	// 50hz 1khz sample rate
-#else
-		  if (underthrottle < underthrottlefilt)
-			  underthrottlefilt -= 0.005f;
-		  else
-			  underthrottlefilt += 0.01f;
-#endif
-// under
-			if (underthrottlefilt < - (float)MIX_THROTTLE_REDUCTION_MAX)
-			  underthrottlefilt = - (float)MIX_THROTTLE_REDUCTION_MAX;
-		  if (underthrottlefilt > 0.1f)
-			  underthrottlefilt = 0.1;
-
-			underthrottle = underthrottlefilt;
-					
-			if (underthrottle > 0.0f)
-			  underthrottle = 0.0001f;
-
-			underthrottle *= ((float)MIX_THROTTLE_REDUCTION_PERCENT / 100.0f);
-#else
-  underthrottle = 0.001f;			
-#endif			
-// over			
-		  if (overthrottlefilt > (float)MIX_THROTTLE_REDUCTION_MAX)
-			  overthrottlefilt = (float)MIX_THROTTLE_REDUCTION_MAX;
-		  if (overthrottlefilt < -0.1f)
-			  overthrottlefilt = -0.1;
-
-
-		  overthrottle = overthrottlefilt;
-
-			
-		  if (overthrottle < 0.0f)
-			  overthrottle = -0.0001f;
-
-			
-			// reduce by a percentage only, so we get an inbetween performance
-			overthrottle *= ((float)MIX_THROTTLE_REDUCTION_PERCENT / 100.0f);
-
-			
-			
-		  if (overthrottle > 0 || underthrottle < 0 )
-		    {		// exceeding max motor thrust
-					float temp = overthrottle + underthrottle;
-			    for (int i = 0; i < 4; i++)
-			      {
-				      mix[i] -= temp;
-			      }
-		    }
-#endif				
-
-
-#ifdef MIX_LOWER_THROTTLE_3
-{
-#ifndef MIX_THROTTLE_REDUCTION_MAX
-#define MIX_THROTTLE_REDUCTION_MAX 0.5f
-#endif
-
-float overthrottle = 0;
-
-for (int i = 0; i < 4; i++)
-		    {
-			    if (mix[i] > overthrottle)
-				    overthrottle = mix[i];
-            }
-
-
-overthrottle -=1.0f;
-// limit to half throttle max reduction
-if ( overthrottle > (float) MIX_THROTTLE_REDUCTION_MAX)  overthrottle = (float) MIX_THROTTLE_REDUCTION_MAX;
-
-if ( overthrottle > 0.0f)
-{
-    for ( int i = 0 ; i < 4 ; i++)
-        mix[i] -= overthrottle;
-}
-#ifdef MIX_THROTTLE_FLASHLED
-if ( overthrottle > 0.1f) ledcommand = 1;
-#endif
-}
-#endif
 
+		if ( i == 0 || mix[i] > mixmax ) mixmax = mix[i];
+		if ( i == 0 || mix[i] < mixmin ) mixmin = mix[i];
+       		}
 
-#ifdef MIX_INCREASE_THROTTLE_3
-{
-#ifndef MIX_THROTTLE_INCREASE_MAX
-#define MIX_THROTTLE_INCREASE_MAX 0.2f
+#ifdef INVERT_YAW_PID
+// we invert again cause it's used by the pid internally (for limit)
+	#ifdef SWITCHABLE_FEATURE_3
+	extern int flash_feature_3;
+		if (flash_feature_3 == 0){
+			pidoutput[2] = -pidoutput[2];
+		}else{
+			//do nothing
+		}
+	#else
+		pidoutput[2] = -pidoutput[2];
+	#endif		
 #endif
-	if (in_air == 1){
-		float underthrottle = 0;
 
-		for (int i = 0; i < 4; i++)
-			{
-					if (mix[i] < underthrottle)
-							underthrottle = mix[i];
-			}
-
-
-		// limit to half throttle max reduction
-		if ( underthrottle < -(float) MIX_THROTTLE_INCREASE_MAX)  underthrottle = -(float) MIX_THROTTLE_INCREASE_MAX;
+		float mixshift = mix_desaturate( mixmax , mixmin );
 
-		if ( underthrottle < 0.0f)
-			{
-					for ( int i = 0 ; i < 4 ; i++)
-            mix[i] -= underthrottle;
-			}
-		#ifdef MIX_THROTTLE_FLASHLED
-			if ( underthrottle < -0.01f) ledcommand = 1;
-		#endif
-	}
-}
-#endif
 
-            
-            
-            
 thrsum = 0;		
 				
 		for ( int i = 0 ; i <= 3 ; i++)
 		{			
+		mix[i] -= mixshift;
 		           
 		#ifdef CLIP_FF
 		mix[i] = clip_ff(mix[i], i);
@@ -920,7 +909,7 @@ thrsum = 0;
 		#ifndef NOMOTORS
 		#ifndef MOTORS_TO_THROTTLE
 		//normal mode
-		pwm_set( i ,motormap( mix[i] ) );
+		pwm_set( i ,motormap( mix[i] , i ) );
 		#else
 		// throttle test mode
 		ledcommand = 1;
@@ -929,12 +918,15 @@ thrsum = 0;
 		#else
 		// no motors mode ( anti-optimization)
 		#warning "NO MOTORS"
-		tempx[i] = motormap( mix[i] );
+		tempx[i] = motormap( mix[i] , i );
 		#endif
 		
 		if ( mix[i] < 0 ) mix[i] = 0;
 		if ( mix[i] > 1 ) mix[i] = 1;
 		thrsum+= mix[i];
+		#ifdef GYRO_CAPTURE
+		capture_motor( i , mix[i] );
+		#endif
 		}	
 		thrsum = thrsum / 4;
 		
@@ -988,6 +980,8 @@ float motorfilter( float motorin ,int number)
     //initial values for the kalman filter 
     float x_est_last[4] ;
     float P_last[4] ; 
+    float K_motor[4] ;
+    int warmup_motor[4] = { KALMAN_WARMUP , KALMAN_WARMUP , KALMAN_WARMUP , KALMAN_WARMUP };
     //the noise in the system 
     const float Q = 0.02;
 //the noise in the system ( variance -  squared )
@@ -1004,16 +998,22 @@ float  motor_kalman( float in , int x)
 
 
     
-        //do a prediction 
-       float x_temp_est = x_est_last[x]; 
+       // constant gain once P has settled, as in the gyro kalman
+       if ( warmup_motor[x] )
+       {
        float P_temp = P_last[x] + Q; 
+       K_motor[x] = P_temp * (1.0f/(P_temp + R));
+       float P = (1- K_motor[x]) * P_temp; 
+       if ( P == P_last[x] ) warmup_motor[x] = 0;
+       else warmup_motor[x]--;
+       P_last[x] = P; 
+       }
 
-       float K = P_temp * (1.0f/(P_temp + R));
-       float x_est = x_temp_est + K * (in - x_temp_est);  
-       float P = (1- K) * P_temp; 
+        //do a prediction 
+       float x_temp_est = x_est_last[x]; 
+       float x_est = x_temp_est + K_motor[x] * (in - x_temp_est);  
        
         //update our last's 
-        P_last[x] = P; 
         x_est_last[x] = x_est; 
 //
 
@@ -1,5 +1,13 @@
 
 
+// debug.boottime[] stages, uS from time_init
+#define BOOT_RX 0
+#define BOOT_SENSORS 1
+#define BOOT_GYROCAL 2
+#define BOOT_IMU 3
+#define BOOT_LOOP 4
+#define BOOT_RGB_PIN 5 // rgb pin taken over, after 2 seconds on the programming port pins
+
 typedef struct debug
 {
 	int gyroid;
@@ -9,6 +17,18 @@ typedef struct debug
 	float timefilt;
     float adcreffilt;
 	float cpu_load;
+	unsigned long boottime[6];
+	float noise_peak_hz[3];
+	float noise_peak_amp[3];
+	float time_sixaxis;
+	float time_control;
+	unsigned long loop_cycles;
+	unsigned long loop_cycles_max;
+	unsigned long irq_off_max;
+	unsigned long isr_latency_max;
+	int stack_free;
+	int gyro_fifo_samples;
+	int gyro_fifo_resets; // resets that left a non empty fifo
 } debug_type;
 
 
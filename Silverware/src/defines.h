@@ -148,6 +148,10 @@ Defines for things that do not normally need changing
 #define REVERSE DIR1
 
 
+// kalman filters stop updating the gain once it has settled, or after this many samples
+// it settles in 120 samples for HZ_10, sooner for the higher frequencies
+#define KALMAN_WARMUP 256
+
 #ifdef KALMAN_GYRO
 // kalman Q/R ratio for Q = 0.02
 // loop time 1000Hz
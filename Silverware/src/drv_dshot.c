@@ -64,6 +64,7 @@
 #include "hardware.h"
 #include "util.h"
 #include "drv_dshot.h"
+#include "irq_timing.h"
 #include "config.h"
 
 #ifdef USE_DSHOT_DRIVER_BETA
@@ -224,23 +225,33 @@ void pwm_set( uint8_t number, float pwm )
 
         #ifdef DSHOT600
         __disable_irq();
+        irq_off_begin();
         bitbang_data1();
+        irq_off_end( IRQ_OFF_DSHOT );
         __enable_irq();
         __ISB();
         __disable_irq();
+        irq_off_begin();
         bitbang_data2();
+        irq_off_end( IRQ_OFF_DSHOT );
         __enable_irq();
         __ISB();
         __disable_irq();
+        irq_off_begin();
         bitbang_data3();
+        irq_off_end( IRQ_OFF_DSHOT );
         __enable_irq();
         __ISB();
         __disable_irq();
+        irq_off_begin();
         bitbang_data4();
+        irq_off_end( IRQ_OFF_DSHOT );
         __enable_irq();
         #else
         __disable_irq();
+		irq_off_begin();
 		bitbang_data();
+		irq_off_end( IRQ_OFF_DSHOT );
         __enable_irq();
         #endif
        for ( uint8_t i = 0; i < 48; ++i )
@@ -76,6 +76,7 @@
 #include "project.h"
 
 #include "config.h"
+#include "irq_timing.h"
 #include "defines.h"
 #include "drv_pwm.h"
 #include "drv_time.h"
@@ -346,7 +347,7 @@ void dshot_dma_start()
 	while( dshot_dma_phase != 0 && (gettime()-time) < LOOPTIME ) { } 	// wait maximum a LOOPTIME for dshot dma to complete
 	if( dshot_dma_phase != 0 ) return;																// skip this dshot command
 
-#if	defined(RGB_LED_DMA) && (RGB_LED_NUMBER>0)
+#if	(RGB_LED_NUMBER>0)
 	/// terminate current RGB transfer
 	extern int	rgb_dma_phase;
 
@@ -515,6 +516,7 @@ void motorbeep()
 
 void DMA1_Channel4_5_IRQHandler(void)
 {
+	ISR_ENTER();
 	DMA_Cmd(DMA1_Channel5, DISABLE);
 	DMA_Cmd(DMA1_Channel2, DISABLE);
 	DMA_Cmd(DMA1_Channel4, DISABLE);
@@ -528,10 +530,11 @@ void DMA1_Channel4_5_IRQHandler(void)
 		case 2:
 			dshot_dma_phase =1;
 			dshot_dma_portB();
+			ISR_EXIT( ISR_DMA1_CH4_5 );
 			return;
 		case 1:
 			dshot_dma_phase =0;
-			#if defined(RGB_LED_DMA) && (RGB_LED_NUMBER>0)
+			#if (RGB_LED_NUMBER>0)
 				extern int rgb_dma_phase;
 				extern void rgb_dma_trigger();
 
@@ -540,6 +543,7 @@ void DMA1_Channel4_5_IRQHandler(void)
 					rgb_dma_trigger();
 				}
 			#endif
+			ISR_EXIT( ISR_DMA1_CH4_5 );
 			return;
 		default :
 			dshot_dma_phase =0;
@@ -547,11 +551,12 @@ void DMA1_Channel4_5_IRQHandler(void)
 	}
 
 
-#if defined(RGB_LED_DMA) && (RGB_LED_NUMBER>0)
+#if (RGB_LED_NUMBER>0)
 	extern int rgb_dma_phase;
 	rgb_dma_phase = 0;
 #endif
 
+	ISR_EXIT( ISR_DMA1_CH4_5 );
 }
 #endif
 
@@ -99,6 +99,18 @@ THE SOFTWARE.
 #endif
 #endif
 
+#ifdef HW_I2C_SPEED_AUTO
+// fastest first, i2c_init() picks the fastest that passes the readback test
+// and drops to the next one if the error rate gets high
+#if ( SYS_CLOCK_FREQ_HZ == 64000000 )
+static const uint32_t hw_i2c_timing[] = { 0x00400615 , 0x00900b22 , 0x00c0216c , 0x10d05880 };
+#else
+static const uint32_t hw_i2c_timing[] = { 0x00400615 , 0x00700818 , 0x00901850 , 0x2060083e , 0x10805e89 };
+#endif
+#undef HW_I2C_TIMINGREG
+#define HW_I2C_TIMINGREG hw_i2c_timing[0]
+#endif
+
 // default if not set
 #ifndef HW_I2C_TIMINGREG
 // 400khz (fast)
@@ -173,159 +185,117 @@ I2C_Cmd(I2C1, ENABLE);
 	
 }
 
-//#define I2C_TIMEOUT 50000
-//#define I2C_CONDITION i2c_timeout > I2C_TIMEOUT
+// status flag wait, about 8000 register reads
+#define HW_I2C_TIMEOUT 8192
 
-#define I2C_CONDITION ((i2c_timeout>>13))
+// after a timeout or nack, a peripheral reset clears the state machine
+static void hw_i2c_error( void)
+{
+	liberror++;
+	I2C1->CR1 &= ~I2C_CR1_PE;
+	// PE low for 3 apb clocks
+	__NOP(); __NOP(); __NOP();
+	I2C1->CR1 |= I2C_CR1_PE;
+}
 
-int hw_i2c_sendheader( int reg, int bytes)
+// direct register reads, a nack ends the wait at once
+static int hw_i2c_wait( uint32_t flag )
 {
+	unsigned int timeout = HW_I2C_TIMEOUT;
+	uint32_t isr;
+	while ( !( ( isr = I2C1->ISR ) & flag ) )
+	{
+		if ( ( isr & I2C_ISR_NACKF ) || !--timeout )
+		{
+			hw_i2c_error();
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#ifdef HW_I2C_SPEED_AUTO
+// index into hw_i2c_timing, returns 0 past the slowest
+int hw_i2c_setspeed( int speed )
+{
+	if ( speed >= (int) ( sizeof( hw_i2c_timing ) / sizeof( hw_i2c_timing[0] ) ) ) return 0;
+	// the timing register is only writable with the peripheral off
+	I2C1->CR1 &= ~I2C_CR1_PE;
+	I2C1->TIMINGR = hw_i2c_timing[speed];
+	I2C1->CR1 |= I2C_CR1_PE;
+	return 1;
+}
+#endif
 
-unsigned int i2c_timeout = 0;
+
+int hw_i2c_sendheader( int reg, int bytes)
+{
+unsigned int i2c_timeout = HW_I2C_TIMEOUT;
 //check i2c ready	
-while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY) == SET)
+while( I2C1->ISR & I2C_ISR_BUSY )
 	{
-		i2c_timeout++;
-		if(I2C_CONDITION)
+		if( !--i2c_timeout )
 			{ 
-			liberror++;
+			hw_i2c_error();
 			return 0;
 			}
 	}
-		
+
 // start transfer	
 I2C_TransferHandling(I2C1, HW_I2C_ADDRESS<<1, bytes, I2C_SoftEnd_Mode, I2C_Generate_Start_Write);
-	
-//i2c_timeout = 0;
-// wait for address to be sent	
-while(I2C_GetFlagStatus(I2C1, I2C_FLAG_TXIS) == RESET)
-		{
-		i2c_timeout++;
-		if(I2C_CONDITION)
-			{ 
-			liberror++;
-			return 0;
-			}
-	}
 
-// send next byte (register location)	
-I2C_SendData(I2C1, (uint8_t)reg);
+// wait for address to be sent	
+if ( !hw_i2c_wait( I2C_ISR_TXIS ) ) return 0;
 	
-//i2c_timeout = 0;
+// send next byte (register location)	
+I2C1->TXDR = (uint8_t)reg;
+
 // wait until last data sent
-while(I2C_GetFlagStatus(I2C1, I2C_FLAG_TXE) == RESET)
-	{
-	i2c_timeout++;
-		if(I2C_CONDITION)
-		{ 
-		liberror++;
-		return 0;
-		}
-	}
-	
-return 1;
+return hw_i2c_wait( I2C_ISR_TXE );
 }
 
 
 
-void hw_i2c_writereg( int reg ,int data)
+int hw_i2c_writereg( int reg ,int data)
 {
-
-unsigned int i2c_timeout = 0;
-
 // send start + writeaddress + register location, common send+receive
-hw_i2c_sendheader( reg,2 );
+if ( !hw_i2c_sendheader( reg,2 ) ) return 0;
+	
 // send register value
-I2C_SendData(I2C1, (uint8_t) data);
+I2C1->TXDR = (uint8_t) data;
+
 // wait for finish	
-while(I2C_GetFlagStatus(I2C1, I2C_FLAG_TC) == RESET)
-	{
-	i2c_timeout++;
-		if(I2C_CONDITION)
-		{ 
-		liberror++;
-		return;
-		}
-	}
+if ( !hw_i2c_wait( I2C_ISR_TC ) ) return 0;
 
 // send stop - end transaction
-I2C_GenerateSTOP(I2C1, ENABLE);
-
-	
-return;	
+I2C1->CR2 |= I2C_CR2_STOP;
+return 1;
 }
 
 
 
-int hw_i2c_readdata( int reg, int *data, int size )
+int hw_i2c_readdata( int reg, uint8_t *data, int size )
 {
-
-static uint8_t i = 0;
-unsigned int i2c_timeout = 0;
-
 	// send start + writeaddress + register location, common send+receive
-hw_i2c_sendheader( reg, 1 );
+if ( !hw_i2c_sendheader( reg, 1 ) ) return 0;
 
 	//send restart + readaddress
 I2C_TransferHandling(I2C1, HW_I2C_ADDRESS<<1 , size, I2C_AutoEnd_Mode, I2C_Generate_Start_Read);
 
 //wait for data
-for(i = 0; i<size; i++)
+for( int i = 0; i<size; i++)
 	{
-	i2c_timeout = 0;	
-	while(I2C_GetFlagStatus(I2C1, I2C_FLAG_RXNE) == RESET)
-		{
-		i2c_timeout++;
-		if(I2C_CONDITION)
-				{
-				liberror++;
-				return 0;
-				}
-		}
-	data[i] = I2C_ReceiveData(I2C1);
+	if ( !hw_i2c_wait( I2C_ISR_RXNE ) ) return 0;
+	data[i] = I2C1->RXDR;
 	}
-
 //data received	
 return 1;
 }
 
-
-
 int hw_i2c_readreg( int reg )
 {
-	int data;
+	uint8_t data = 0;
 	hw_i2c_readdata( reg, &data, 1 );
 	return data;
 }
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
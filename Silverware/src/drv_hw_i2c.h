@@ -7,9 +7,10 @@
 
 
 void hw_i2c_init( void);
-int hw_i2c_readdata( int reg, int *data, int size );
+int hw_i2c_readdata( int reg, uint8_t *data, int size );
 int hw_i2c_readreg( int reg );
-void hw_i2c_writereg( int reg ,int data);
+int hw_i2c_writereg( int reg ,int data);
+int hw_i2c_setspeed( int speed );
 			
 
 
@@ -32,6 +32,7 @@ THE SOFTWARE.
 #include "drv_hw_i2c.h"
 
 #include "config.h"
+#include "util.h"
 
 #ifndef USE_HARDWARE_I2C
 #ifndef USE_SOFTWARE_I2C
@@ -41,8 +42,74 @@ THE SOFTWARE.
 #endif
 #endif
 
+#if ( defined(USE_HARDWARE_I2C) && defined(HW_I2C_SPEED_AUTO) ) || ( defined(USE_SOFTWARE_I2C) && defined(SOFTI2C_SPEED_AUTO) )
+#define I2C_SPEED_AUTO
+#endif
+
+// a higher error rate drops to the next slower speed ( SPEED_AUTO )
+#define I2C_SLOWER_RATE 0.02f
+
 int liberror = 0;
 
+// failed reads per read, filtered over about 100 reads
+float i2c_error_rate = 0;
+
+#ifdef I2C_SPEED_AUTO
+static int i2c_speed = 0;
+// the boot probe picks the speed itself
+static int probing = 0;
+
+// returns 0 past the slowest speed
+static int i2c_setspeed( int speed )
+{
+	#ifdef USE_HARDWARE_I2C
+	return hw_i2c_setspeed( speed );
+	#else
+	return softi2c_setspeed( speed );
+	#endif
+}
+
+// write and read back SMPLRT_DIV ( set again in sixaxis_init ) and the gyro id
+static int i2c_probe( void)
+{
+	int errors = liberror;
+	probing = 1;
+	int id = i2c_readreg( 117 );
+	int pass = ( 0 != id && 255 != id );
+	
+	for ( int i = 0 ; i < 32 && pass ; i++ )
+	{
+		uint8_t value = 0x55 ^ ( i * 0x3B );
+		uint8_t data[2];
+		i2c_writereg( 25 , value );
+		if ( !i2c_readdata( 25 , data , 2 ) || data[0] != value ) pass = 0;
+		if ( i2c_readreg( 117 ) != id ) pass = 0;
+	}
+	if ( liberror != errors ) pass = 0;
+	
+	i2c_writereg( 25 , 0 );
+	// probe errors are not bus errors
+	liberror = errors;
+	i2c_error_rate = 0;
+	probing = 0;
+	return pass;
+}
+#endif
+
+// every transfer counts in the error rate
+static void i2c_result( int ok )
+{
+	lpf( &i2c_error_rate , ok ? 0.0f : 1.0f , 0.99f );
+	
+	#ifdef I2C_SPEED_AUTO
+	if ( !probing && i2c_error_rate > I2C_SLOWER_RATE && i2c_setspeed( i2c_speed + 1 ) )
+	{
+		i2c_speed++;
+		i2c_error_rate = 0;
+	}
+	#endif
+}
+
 void i2c_init( void)
 {
 	#ifdef USE_HARDWARE_I2C
@@ -57,53 +124,55 @@ void i2c_init( void)
 	#warning I2C FUNCTIONS DISABLED
 	#endif
 	
+	#ifdef I2C_SPEED_AUTO
+	// fastest speed that passes, the slowest if none does
+	while ( !i2c_probe() && i2c_setspeed( i2c_speed + 1 ) ) i2c_speed++;
+	#endif
 }
 
 
 void i2c_writereg( int reg ,int data)
 {
+	int ok = 1;
+	
 	#ifdef USE_HARDWARE_I2C
-	hw_i2c_writereg( reg , data);
+	ok = hw_i2c_writereg( reg , data);
 	#endif
 	
 	#ifdef USE_SOFTWARE_I2C
-	softi2c_write( SOFTI2C_GYRO_ADDRESS , reg , data);
+	ok = softi2c_write( SOFTI2C_GYRO_ADDRESS , reg , data);
 	#endif
 	
-	#ifdef USE_DUMMY_I2C
-
-	#endif
+	i2c_result( ok );
 }
 
 
-int i2c_readdata( int reg, int *data, int size )
+int i2c_readdata( int reg, uint8_t *data, int size )
 {
+	int ok = 1;
+	
 	#ifdef USE_HARDWARE_I2C
-	return hw_i2c_readdata( reg, data, size );
+	ok = hw_i2c_readdata( reg, data, size );
 	#endif
 	
 	#ifdef USE_SOFTWARE_I2C
-	softi2c_readdata( SOFTI2C_GYRO_ADDRESS , reg , data, size );
-	return 1;
+	ok = softi2c_readdata( SOFTI2C_GYRO_ADDRESS , reg , data, size );
 	#endif
 	
-	#ifdef USE_DUMMY_I2C
-	return 1;
-	#endif
+	i2c_result( ok );
+	
+	return ok;
 }
 
 int i2c_readreg( int reg )
 {
-	#ifdef USE_HARDWARE_I2C
-	return hw_i2c_readreg(reg);
-	#endif
-	
-	#ifdef USE_SOFTWARE_I2C
-	return softi2c_read( SOFTI2C_GYRO_ADDRESS , reg);
-	#endif
-	
 	#ifdef USE_DUMMY_I2C
 	return 255;
+	#else
+	// through i2c_readdata for the error rate
+	uint8_t data = 0;
+	i2c_readdata( reg , &data , 1 );
+	return data;
 	#endif
 }
 
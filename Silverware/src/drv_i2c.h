@@ -6,8 +6,15 @@
 
 
 
+#include <inttypes.h>
+
+// gyro reads failing more often than this stop the quad ( failloop 8 )
+#define I2C_FAIL_RATE 0.1f
+
+extern float i2c_error_rate;
+
 void i2c_init( void);
-int i2c_readdata( int reg, int *data, int size );
+int i2c_readdata( int reg, uint8_t *data, int size );
 int i2c_readreg( int reg );
 void i2c_writereg( int reg ,int data);
 			
@@ -15,8 +15,15 @@
 #define PWMTOP (( SYS_CLOCK_FREQ_HZ / PWMFREQ ) - 1)
 
 // pwm frequency checking macros
-#if ( PWMTOP< 1400 ) 
-  // approx 34Khz
+// with the dither the resolution is kept at higher frequencies
+#ifdef PWM_DITHER
+#define PWMTOP_MIN 700
+#else
+#define PWMTOP_MIN 1400
+#endif
+
+#if ( PWMTOP< PWMTOP_MIN ) 
+  // approx 34Khz ( 68Khz with PWM_DITHER )
 	#undef PWMTOP
 	#define PWMTOP 6000
 	#warning PWM FREQUENCY TOO HIGH
@@ -613,7 +620,17 @@ void init_timer( TIM_TypeDef* TIMx , int period)
   TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
 
   TIM_TimeBaseInit( TIMx, &TIM_TimeBaseStructure);
-	
+
+	// new period and compare values load at the update event, so a write
+	// from the loop never cuts a pulse short or gives two in one period
+	TIM_ARRPreloadConfig( TIMx , ENABLE );
+	TIMx->CCMR1 |= TIM_CCMR1_OC1PE;
+	if ( IS_TIM_LIST3_PERIPH( TIMx ) )
+	{
+		// timers with 4 channels
+		TIMx->CCMR1 |= TIM_CCMR1_OC2PE;
+		TIMx->CCMR2 |= TIM_CCMR2_OC3PE | TIM_CCMR2_OC4PE;
+	}
 }
 
 
@@ -667,13 +684,29 @@ void motorbeep( void)
 
 #include  <math.h>
 
+#ifdef PWM_DITHER
+// part of a count left over from the last update, per motor
+float pwm_residual[4];
+#endif
+
 void pwm_set( uint8_t number , float pwmf)
 {
+
+#ifdef PWM_DITHER
+// first order sigma delta, the average over a few loops has the full resolution
+if ( number > 3 ) return;
+float pwmcount = pwmf * PWMTOP + pwm_residual[number];
+int pwm = pwmcount;
+pwm_residual[number] = pwmcount - pwm;
 	
+if ( pwm < 0 ) { pwm = 0; pwm_residual[number] = 0; }
+if ( pwm > PWMTOP ) { pwm = PWMTOP; pwm_residual[number] = 0; }
+#else
 int pwm = pwmf * PWMTOP ;
 	
 if ( pwm < 0 ) pwm = 0;
 if ( pwm > PWMTOP ) pwm = PWMTOP;
+#endif
 
 	
   switch( number)
@@ -6,18 +6,26 @@
 #include "config.h"
 #include "drv_time.h"
 #include "util.h"
+#include "irq_timing.h"
+#include "debug.h"
 
 
 
 #if ( RGB_LED_NUMBER > 0)
-void rgb_send( int data);
 
-#ifdef RGB_LED_DMA
+// ws2812 driver, DMA only
+// the leds are updated by TIM1 + 3 DMA channels writing the port BSRR/BRR registers
+// rgb_led.c renders into rgb_led_value[], a frame is only sent if it changed
 
 #define RGB_BIT_TIME 		((SYS_CLOCK_FREQ_HZ/1000/800)-1)
 #define RGB_T0H_TIME 		(RGB_BIT_TIME*0.30 + 0.05 )
 #define RGB_T1H_TIME 		(RGB_BIT_TIME*0.60 + 0.05 )
 
+// pin bit in the byte addressed by the dma channel 2 (BRR low or high byte)
+#define RGB_PIN_BYTE ( (RGB_PIN > GPIO_Pin_7) ? (RGB_PIN >> 8) : RGB_PIN )
+// 4 data bits -> 4 dma bytes, msb first, pin set for a 0 bit ( reset at T0H )
+#define RGB_NIBBLE( i ) ( ( ( (i)&0x01 ? 0 : RGB_PIN_BYTE ) << 24 ) | ( ( (i)&0x02 ? 0 : RGB_PIN_BYTE ) << 16 ) \
+												| ( ( (i)&0x04 ? 0 : RGB_PIN_BYTE ) << 8 ) | ( (i)&0x08 ? 0 : RGB_PIN_BYTE ) )
 
 extern int rgb_led_value[];
 	
@@ -32,18 +40,32 @@ const int offset = RGB_PIN > GPIO_Pin_7;
 
 volatile uint32_t	rgb_data_portA[ RGB_LED_NUMBER*24/4 ] = { 0 };	// DMA buffer: reset output when bit data=0 at TOH timing
 volatile uint16_t	rgb_portX[1] = { RGB_PIN };						// sum of all rgb pins at port  
-volatile uint32_t RGB_DATA16[16];									// 4-bit look-up table for dma buffer making
 
-void rgb_init()
+// 4-bit look-up table for dma buffer making, in flash
+const uint32_t RGB_DATA16[16] = 
 {
-	if ( (RGB_PIN == GPIO_Pin_13 || RGB_PIN == GPIO_Pin_14) && RGB_PORT == GPIOA ) {
-		// programming port used
-		// wait until 2 seconds from powerup passed
-		while ( gettime() < 2e6 );
-	}
-    
+	RGB_NIBBLE( 0 ), RGB_NIBBLE( 1 ), RGB_NIBBLE( 2 ), RGB_NIBBLE( 3 ),
+	RGB_NIBBLE( 4 ), RGB_NIBBLE( 5 ), RGB_NIBBLE( 6 ), RGB_NIBBLE( 7 ),
+	RGB_NIBBLE( 8 ), RGB_NIBBLE( 9 ), RGB_NIBBLE( 10 ), RGB_NIBBLE( 11 ),
+	RGB_NIBBLE( 12 ), RGB_NIBBLE( 13 ), RGB_NIBBLE( 14 ), RGB_NIBBLE( 15 ),
+};
+
+// frame currently in the dma buffer / on the leds
+int rgb_led_frame[RGB_LED_NUMBER];
+// rgb_led_value[] differs from the frame sent
+int rgb_frame_pending = 0;
+
+// programming port used ( swd pins ), the pin is taken over 2 seconds from powerup
+#define RGB_PIN_SWD ( (RGB_PIN == GPIO_Pin_13 || RGB_PIN == GPIO_Pin_14) && RGB_PORT == GPIOA )
+// pin not taken over yet, rgb_dma_start() does it without holding up the boot
+int rgb_pin_pending = 0;
+
+#ifdef DEBUG
+extern debug_type debug;
+#endif
 
-	
+static void rgb_pin_init( void )
+{
  GPIO_InitTypeDef  GPIO_InitStructure;
 
   GPIO_InitStructure.GPIO_Mode = GPIO_Mode_OUT;
@@ -53,6 +75,19 @@ void rgb_init()
 
 	GPIO_InitStructure.GPIO_Pin = RGB_PIN;
 	GPIO_Init( RGB_PORT, &GPIO_InitStructure );
+
+	rgb_pin_pending = 0;
+#ifdef DEBUG
+	debug.boottime[BOOT_RGB_PIN] = gettime();
+#endif
+}
+
+void rgb_init()
+{
+	if ( RGB_PIN_SWD && gettime() < 2e6 )
+		rgb_pin_pending = 1;
+	else
+		rgb_pin_init();
 	
 #ifndef USE_DSHOT_DMA_DRIVER	
 	// RGB timer/DMA init
@@ -154,25 +189,10 @@ void rgb_init()
 
 	for (int i=0;i<RGB_LED_NUMBER;i++) {
 		rgb_led_value[i]=0;
+		rgb_led_frame[i]=0;
 	}
+	// clear the strip once
 	if( !rgb_dma_phase )	rgb_dma_phase = 3;
-	
-int pin = rgb_portX[0];
-    
-    if ( offset ) 
-    {
-        pin >>=8;
-    }
-    
-	for( int i=0;i<16;i++ ) {
-		RGB_DATA16[ i ]  = (i & 0x01) ? 0:pin;
-		RGB_DATA16[ i ]<<= 8;
-		RGB_DATA16[ i ] |= (i & 0x02) ? 0:pin;
-		RGB_DATA16[ i ]<<= 8;
-		RGB_DATA16[ i ] |= (i & 0x04) ? 0:pin;
-		RGB_DATA16[ i ]<<= 8;
-		RGB_DATA16[ i ] |= (i & 0x08) ? 0:pin;
-	}
 }
 
 void rgb_dma_buffer_making()
@@ -180,12 +200,13 @@ void rgb_dma_buffer_making()
 	// generate rgb dma packet
 	int j=0;
 	for( int n=0;n<RGB_LED_NUMBER;n++ ) {
-		rgb_data_portA[ j++ ] = RGB_DATA16[ (rgb_led_value[ n ] >> 20) & 0x0f ];
-		rgb_data_portA[ j++ ] = RGB_DATA16[ (rgb_led_value[ n ] >> 16) & 0x0f ];
-		rgb_data_portA[ j++ ] = RGB_DATA16[ (rgb_led_value[ n ] >> 12) & 0x0f ];
-		rgb_data_portA[ j++ ] = RGB_DATA16[ (rgb_led_value[ n ] >>  8) & 0x0f ];
-		rgb_data_portA[ j++ ] = RGB_DATA16[ (rgb_led_value[ n ] >>  4) & 0x0f ];
-		rgb_data_portA[ j++ ] = RGB_DATA16[ (rgb_led_value[ n ]      ) & 0x0f ];	
+		int value = rgb_led_frame[ n ];
+		rgb_data_portA[ j++ ] = RGB_DATA16[ (value >> 20) & 0x0f ];
+		rgb_data_portA[ j++ ] = RGB_DATA16[ (value >> 16) & 0x0f ];
+		rgb_data_portA[ j++ ] = RGB_DATA16[ (value >> 12) & 0x0f ];
+		rgb_data_portA[ j++ ] = RGB_DATA16[ (value >>  8) & 0x0f ];
+		rgb_data_portA[ j++ ] = RGB_DATA16[ (value >>  4) & 0x0f ];
+		rgb_data_portA[ j++ ] = RGB_DATA16[ (value      ) & 0x0f ];	
 	}	
 }
 
@@ -224,11 +245,30 @@ void rgb_dma_trigger()
 	TIM_Cmd( TIM1, ENABLE );
 }
 
+// called every loop, one step per call
 void rgb_dma_start()
 {
-	if( rgb_dma_phase <= 1 ) 
+	if ( rgb_pin_pending )
+	{
+		if ( gettime() < 2e6 )
+			return;
+		rgb_pin_init();
+	}
+
+	if( rgb_dma_phase == 1 ) 
 		return;
 
+	if( rgb_dma_phase == 0 ) {
+		if ( !rgb_frame_pending )
+			return;
+		// latch the new frame, the dma buffer is free
+		for ( int i = 0 ; i < RGB_LED_NUMBER ; i++)
+			rgb_led_frame[i] = rgb_led_value[i];
+		rgb_frame_pending = 0;
+		rgb_dma_phase = 3;
+		return;
+	}
+	
 	if( rgb_dma_phase ==3 ) {
 		rgb_dma_buffer_making();
 		rgb_dma_phase = 2;	
@@ -245,17 +285,26 @@ void rgb_dma_start()
 	rgb_dma_trigger();
 }
 
-void rgb_send( int data )
+// new frame rendered in rgb_led_value[], send it if anything changed
+void rgb_send_frame( void )
 {
-	if( !rgb_dma_phase )	rgb_dma_phase = 3;
+	for ( int i = 0 ; i < RGB_LED_NUMBER ; i++)
+	{
+		if ( rgb_led_value[i] != rgb_led_frame[i] )
+		{
+			rgb_frame_pending = 1;
+			return;
+		}
+	}
 }
 
 
 // if dshot dma is used the routine is in that file
-#if !defined(USE_DSHOT_DMA_DRIVER) && defined(RGB_LED_DMA) && (RGB_LED_NUMBER>0) 
+#if !defined(USE_DSHOT_DMA_DRIVER) 
 
 void DMA1_Channel4_5_IRQHandler(void)
 {	
+	ISR_ENTER();
 	DMA_Cmd(DMA1_Channel5, DISABLE);
 	DMA_Cmd(DMA1_Channel2, DISABLE);
 	DMA_Cmd(DMA1_Channel4, DISABLE);		
@@ -265,110 +314,9 @@ void DMA1_Channel4_5_IRQHandler(void)
 	TIM_Cmd( TIM1, DISABLE );
 
     rgb_dma_phase = 0;
-}
-#endif
-
-
-
-#else
-
-
-
-
-
-
-
-
-
-
-
 
-
-
-
-// sets all leds to a brightness
-void rgb_init(void)
-{    
-	// spi port inits
-
-	if ( (RGB_PIN == GPIO_Pin_13 || RGB_PIN == GPIO_Pin_14) && RGB_PORT == GPIOA ) 
-	{
-		// programming port used
-		
-		// wait until 2 seconds from powerup passed
-		while ( gettime() < 2e6 ) ;
-	}
-	
-		GPIO_InitTypeDef  GPIO_InitStructure;
-	
-  GPIO_InitStructure.GPIO_Mode = GPIO_Mode_OUT;
-  GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
-  GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
-  GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
-
-	GPIO_InitStructure.GPIO_Pin = RGB_PIN;
-	GPIO_Init(RGB_PORT, &GPIO_InitStructure);
-
-	for (int i = 0 ; i < RGB_LED_NUMBER ; i++)
-	{
-		rgb_send( 0 );
-	}	
-}
-
-#define RGBHIGH gpioset( RGB_PORT, RGB_PIN)
-#define RGBLOW gpioreset( RGB_PORT, RGB_PIN);
-
-#pragma push
-
-#pragma Otime
-#pragma O2
-
-void delay1a()
-{
-	uint8_t count = 2; 
-	while (count--);
-}
-
-void delay1b()
-{
-	uint8_t count = 2; 
-	while (count--);
-}
-
-void delay2a()
-{
-	uint8_t count = 1; 
-	while (count--);
-}
-
-void delay2b()
-{
-	uint8_t count = 3; 
-	while (count--);
+	ISR_EXIT( ISR_DMA1_CH4_5 );
 }
-
-void rgb_send( int data)
-{
-for ( int i =23 ; i >=0 ; i--)
-	{
-		if (  (data>>i)&1  ) 
-		{
-			RGBHIGH;
-			delay1a();
-			RGBLOW;
-			delay1b();
-		}
-		else 
-		{
-			RGBHIGH;
-			delay2a();
-			RGBLOW;
-			delay2b();
-		}
-	}
-}
-#pragma pop
-
 #endif
 
 
@@ -380,7 +328,11 @@ void rgb_init(void)
 {
 }
 
-void rgb_send( int data)
+void rgb_send_frame( void )
+{
+}
+
+void rgb_dma_start( void )
 {
 }
 #endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "drv_serial.h"
 #include "config.h"
+#include "irq_timing.h"
 
 
 // enable serial driver ( pin SWCLK after calibration) 
@@ -13,31 +14,98 @@
 //#define SERIAL_ENABLE
 
 
-#define SERIAL_BUFFER_SIZE 64
+// tx ring buffer, power of 2
+#define SERIAL_BUFFER_SIZE 128
+#define SERIAL_BUFFER_MASK ( SERIAL_BUFFER_SIZE - 1 )
 
 #define SERIAL_BAUDRATE 115200
 
+// binary frame: sync, type, length, payload, xor checksum
+#define SERIAL_FRAME_SYNC 0xA5
+
 #ifdef SERIAL_ENABLE
 
-uint8_t buffer[SERIAL_BUFFER_SIZE];
-char buffer_start = 0;
-char buffer_end = 0;
+// usart1 tx dma ( channel 2 ) is used by the rgb led and dshot dma drivers
+// in that case fall back to one interrupt per byte
+#if ( RGB_LED_NUMBER > 0 ) || defined(USE_DSHOT_DMA_DRIVER)
+#define SERIAL_TX_IRQ
+#endif
+
+uint8_t serial_buffer[SERIAL_BUFFER_SIZE];
+volatile int serial_head = 0;		// next byte written
+volatile int serial_tail = 0;		// next byte sent
+volatile int serial_dma_count = 0;	// bytes in the running dma transfer
+
+// frames dropped because the buffer was full
+unsigned int serial_overflow = 0;
 
 
+#ifdef SERIAL_TX_IRQ
+
 void USART1_IRQHandler(void)
 {
-	if (buffer_end != buffer_start)
+	ISR_ENTER();
+	if ( serial_head != serial_tail )
 	  {
-		  USART_SendData(USART1, buffer[buffer_start]);
-		  buffer_start++;
-		  buffer_start = buffer_start % (SERIAL_BUFFER_SIZE);
+		  USART_SendData(USART1, serial_buffer[serial_tail]);
+		  serial_tail = ( serial_tail + 1 ) & SERIAL_BUFFER_MASK;
 	  }
 	else
 	  {
 		USART_ITConfig(USART1, USART_IT_TXE, DISABLE);
 	  }
+
+	ISR_EXIT( ISR_USART1 );
+}
+
+static void serial_kick( void )
+{
+	USART_ITConfig(USART1, USART_IT_TXE, ENABLE);
 }
 
+#else
+
+// start a dma transfer of the bytes up to the head or the end of the buffer
+// called with the dma interrupt masked or from it
+static void serial_dma_start( void )
+{
+	int head = serial_head;
+	int tail = serial_tail;
+	
+	if ( serial_dma_count || head == tail ) return;
+	
+	int count = head > tail ? head - tail : SERIAL_BUFFER_SIZE - tail;
+	
+	DMA1_Channel2->CCR &= ~DMA_CCR_EN;
+	DMA1_Channel2->CMAR = (uint32_t)&serial_buffer[tail];
+	DMA1_Channel2->CNDTR = count;
+	serial_dma_count = count;
+	DMA1_Channel2->CCR |= DMA_CCR_EN;
+}
+
+void DMA1_Channel2_3_IRQHandler(void)
+{
+	ISR_ENTER();
+	DMA_ClearITPendingBit(DMA1_IT_TC2);
+	DMA1_Channel2->CCR &= ~DMA_CCR_EN;
+	
+	serial_tail = ( serial_tail + serial_dma_count ) & SERIAL_BUFFER_MASK;
+	serial_dma_count = 0;
+	
+	serial_dma_start();
+
+	ISR_EXIT( ISR_DMA1_CH2_3 );
+}
+
+static void serial_kick( void )
+{
+	NVIC_DisableIRQ(DMA1_Channel2_3_IRQn);
+	serial_dma_start();
+	NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+}
+
+#endif
+
 void serial_init(void)
 {
 	
@@ -67,12 +135,38 @@ void serial_init(void)
 	
   USART_Init(USART1, &USART_InitStructure);
 
-//	USART_ITConfig(USART1, USART_IT_TXE, ENABLE);
-	USART_Cmd(USART1, ENABLE);
-	 
 	NVIC_InitTypeDef NVIC_InitStructure;
-	
+
+#ifdef SERIAL_TX_IRQ
+//	USART_ITConfig(USART1, USART_IT_TXE, ENABLE);
 	NVIC_InitStructure.NVIC_IRQChannel = USART1_IRQn;
+#else
+	DMA_InitTypeDef DMA_InitStructure;
+	
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+	
+	DMA_StructInit(&DMA_InitStructure);
+	DMA_DeInit(DMA1_Channel2);
+	DMA_InitStructure.DMA_PeripheralBaseAddr = 		(uint32_t)&USART1->TDR;
+	DMA_InitStructure.DMA_MemoryBaseAddr = 				(uint32_t)serial_buffer;
+	DMA_InitStructure.DMA_DIR = 									DMA_DIR_PeripheralDST;
+	DMA_InitStructure.DMA_BufferSize = 						1;
+	DMA_InitStructure.DMA_PeripheralInc = 				DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = 						DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = 		DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = 				DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = 									DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = 							DMA_Priority_Low;
+	DMA_InitStructure.DMA_M2M = 									DMA_M2M_Disable;
+	DMA_Init(DMA1_Channel2, &DMA_InitStructure);
+	DMA_ITConfig(DMA1_Channel2, DMA_IT_TC, ENABLE);
+	
+	USART_DMACmd(USART1, USART_DMAReq_Tx, ENABLE);
+	
+	NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel2_3_IRQn;
+#endif
+	USART_Cmd(USART1, ENABLE);
+	 	
   NVIC_InitStructure.NVIC_IRQChannelPriority = 0;
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
   NVIC_Init(&NVIC_InitStructure);
@@ -80,25 +174,64 @@ void serial_init(void)
 
 }
 
+// queue a whole frame, all or nothing
+// returns 0 and counts an overflow if it does not fit
+int serial_send( const uint8_t * data , int len )
+{
+	int head = serial_head;
+	int used = ( head - serial_tail ) & SERIAL_BUFFER_MASK;
+	
+	if ( len > SERIAL_BUFFER_MASK - used )
+	{
+		serial_overflow++;
+		return 0;
+	}
+	
+	for ( int i = 0 ; i < len ; i++ )
+	{
+		serial_buffer[head] = data[i];
+		head = ( head + 1 ) & SERIAL_BUFFER_MASK;
+	}
+	serial_head = head;
+	
+	serial_kick();
+	return 1;
+}
+
+// binary telemetry frame, payload up to SERIAL_FRAME_MAX bytes
+int serial_frame_send( uint8_t type , const void * payload , int len )
+{
+	uint8_t frame[SERIAL_FRAME_MAX + 4];
+	const uint8_t * p = payload;
+	
+	if ( len > SERIAL_FRAME_MAX ) return 0;
+	
+	frame[0] = SERIAL_FRAME_SYNC;
+	frame[1] = type;
+	frame[2] = len;
+	
+	uint8_t checksum = type ^ len;
+	for ( int i = 0 ; i < len ; i++ )
+	{
+		frame[3 + i] = p[i];
+		checksum ^= p[i];
+	}
+	frame[3 + len] = checksum;
+	
+	return serial_send( frame , len + 4 );
+}
 
 int fputc(int ch, FILE * f)
 {			
-		buffer[buffer_end] = (char)ch;
-		buffer_end++;
-		buffer_end = buffer_end % (SERIAL_BUFFER_SIZE);
-
-		USART_ITConfig(USART1, USART_IT_TXE, ENABLE);
+	uint8_t c = ch;
+	serial_send( &c , 1 );
 	return ch;
 }
 
 void buffer_add(int val )
 {
-	buffer[buffer_end] = (char)val;
-	buffer_end++;
-	buffer_end = buffer_end % (SERIAL_BUFFER_SIZE);
-
-	USART_ITConfig(USART1, USART_IT_TXE, ENABLE);
-	return;
+	uint8_t c = val;
+	serial_send( &c , 1 );
 }
 
 #else
@@ -113,6 +246,16 @@ void buffer_add(int val )
 	
 }
 
+int serial_send( const uint8_t * data , int len )
+{
+	return 0;
+}
+
+int serial_frame_send( uint8_t type , const void * payload , int len )
+{
+	return 0;
+}
+
 #endif
 
 
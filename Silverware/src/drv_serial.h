@@ -1,3 +1,16 @@
+
+#include <inttypes.h>
+
 void serial_init(void);
 
+// largest binary frame payload
+#define SERIAL_FRAME_MAX 60
+
+// binary frame types
+#define SERIAL_FRAME_DEBUG 1
+#define SERIAL_FRAME_CAPTURE_HEADER 2
+#define SERIAL_FRAME_CAPTURE_DATA 3
+
+int serial_send( const uint8_t * data , int len );
+int serial_frame_send( uint8_t type , const void * payload , int len );
 
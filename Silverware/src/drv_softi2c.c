@@ -25,352 +25,217 @@ THE SOFTWARE.
 
 #include "project.h"
 #include <stdint.h>
-#include <stdio.h>
 
 #include "drv_softi2c.h"
 #include "config.h"
 
 
-//#define i2cdebug
-
-static GPIO_InitTypeDef  sdainit;
-
-void delay(int);
-
 // inter-version fix
 #ifndef SOFTI2C_SPEED_SLOW1
 #ifndef SOFTI2C_SPEED_SLOW2
 #ifndef SOFTI2C_SPEED_FAST
+#ifndef SOFTI2C_SPEED_AUTO
 	#define SOFTI2C_SPEED_FAST
 #endif
 #endif
 #endif
-
-#ifdef SOFTI2C_SPEED_FAST
-#define _delay  //
-#define _delay2 //
 #endif
 
-#ifdef SOFTI2C_SPEED_SLOW1
-#ifdef __GNUC__
-void delayraw()
-{
-	volatile uint8_t count = 1;
-	while (count--);
-}
+// wait loops per half clock, about 4 cycles each
+// with SOFTI2C_SPEED_AUTO i2c_init() picks the shortest that passes the readback test
+static const uint8_t softi2c_waits[] = { 0 , 1 , 2 , 4 , 8 , 16 , 32 };
+
+#if defined(SOFTI2C_SPEED_AUTO)
+static int softi2c_wait = 0;
+#elif defined(SOFTI2C_SPEED_SLOW2)
+static int softi2c_wait = 32;
+#elif defined(SOFTI2C_SPEED_SLOW1)
+static int softi2c_wait = 4;
 #else
-void delayraw()
-{
-	uint8_t count = 1;
-	while (count--);
-}
-#endif
-#define _delay  delayraw()
-#define _delay2 //delay(1)
+static int softi2c_wait = 1;
 #endif
 
-#ifdef SOFTI2C_SPEED_SLOW2
-#define _delay  delay(1)
-#define _delay2 //delay(1)
-#endif
+extern int liberror;
 
-	#ifdef i2cdebug
-	int debug = 1;   		// prints error info, set in setup()
-	#endif
-	
-	int sda;
-	int scl;	
-	
-	void _sendstart(void);
-	void _sendstop(void);
-	void sdalow(void);
-	void sdahigh(void);
-	void scllow(void);
-	void sclhigh(void);
-	void _restart(void);	
-	int _readbyte( int); 
-	int _sendbyte( int);
-	int _readsda(void);
-	
-	int sdaout = 0;
-void setoutput(void);
-
-////////////////////////////////
-/////////I2C Routines//////////
-
-
- void sdalow()
-{
-	if(!sdaout) setoutput();	
-  SOFTI2C_SDAPORT->BRR = SOFTI2C_SDAPIN;
-  sda=0;
-	_delay;
-}
+// register level pin access, sda stays an open drain output and is read back from IDR
+#define SDAHIGH SOFTI2C_SDAPORT->BSRR = SOFTI2C_SDAPIN
+#define SDALOW SOFTI2C_SDAPORT->BRR = SOFTI2C_SDAPIN
+#define SCLHIGH SOFTI2C_SCLPORT->BSRR = SOFTI2C_SCLPIN
+#define SCLLOW SOFTI2C_SCLPORT->BRR = SOFTI2C_SCLPIN
+#define READSDA ( SOFTI2C_SDAPORT->IDR & SOFTI2C_SDAPIN )
 
+#define WAIT for ( int w = wait ; w ; w-- ) __NOP()
 
-  void sdahigh()
-{
-	if(!sdaout) setoutput();
-	SOFTI2C_SDAPORT->BSRR = SOFTI2C_SDAPIN;
-	_delay;
-  sda = 1; 
-}
+// one bit, sda set while scl is low
+#define SENDBIT( bit ) \
+	if ( value & bit ) SDAHIGH; else SDALOW; \
+	WAIT; SCLHIGH; WAIT; SCLLOW;
 
+#define READBIT( bit ) \
+	WAIT; SCLHIGH; WAIT; \
+	if ( READSDA ) value |= bit; \
+	SCLLOW;
 
-  void scllow()
-{
- SOFTI2C_SCLPORT->BRR = SOFTI2C_SCLPIN;
-_delay;
- scl = 0;
-}
+#pragma push
 
-  void sclhigh()
-{
-  SOFTI2C_SCLPORT->BSRR = SOFTI2C_SCLPIN;
-	_delay;
- scl = 1; 
-}
-
-  void sclhighlow()
-{
- SOFTI2C_SCLPORT->BSRR = SOFTI2C_SCLPIN;
-	_delay;
- SOFTI2C_SCLPORT->BRR = SOFTI2C_SCLPIN;
-_delay;
- scl = 0;
-}
+#pragma Otime
+#pragma O2
 
-void setinput()
+static void softi2c_start( int wait )
 {
-	sdaout = 0;
-  sdainit.GPIO_Mode = GPIO_Mode_IN;
-  GPIO_Init(SOFTI2C_SDAPORT, &sdainit);	
-	
-	_delay2;
- }
-
-void setoutput()
-{
-	sdaout = 1;
-  sdainit.GPIO_Mode = GPIO_Mode_OUT;
-  GPIO_Init(SOFTI2C_SDAPORT, &sdainit);
-	_delay2;
+	SDAHIGH;
+	SCLHIGH;
+	WAIT;
+	SDALOW;
+	WAIT;
+	SCLLOW;
 }
 
-int _readsda()
+static void softi2c_restart( int wait )
 {
-#ifdef i2cdebug
-  if (!sda)  printf("_readsda: sda low");
-#endif
-//if ( sdaout) setinput();	
-//return ( GPIO_ReadInputDataBit(SOFTI2C_SDAPORT, SOFTI2C_SDAPIN) ); 
-return	SOFTI2C_SDAPORT->IDR & SOFTI2C_SDAPIN;
+	SDAHIGH;
+	WAIT;
+	SCLHIGH;
+	WAIT;
+	SDALOW;
+	WAIT;
+	SCLLOW;
 }
 
-
-void _sendstart()
-{
- if (scl == 0) 
- {
- #ifdef i2cdebug
-   printf("_sendstart: scl low"); 
- #endif
-  sclhigh();
- } 
- if (sda == 1)
+static void softi2c_stop( int wait )
 {
-  if(!_readsda())
-	{
-	#ifdef i2cdebug
-	printf("_sendstart: sda pulled low by slave"); 
-	#endif
-	//error1 = 1;
-	}
-  sdalow();
-}
- else {
-	  #ifdef i2cdebug
-    printf("_sendstart: sda low"); 
-	  #endif
-       } 
+	SDALOW;
+	WAIT;
+	SCLHIGH;
+	WAIT;
+	SDAHIGH;
+	WAIT;
 }
 
-
-void _restart()
+// returns 0 on ack
+static int softi2c_sendbyte( int value , int wait )
 {
- #ifdef i2cdebug 
- if (scl == 1) printf("_restart: scl high"); 
- #endif
- if (sda == 0) 
- {
-   sdahigh();
- }
- sclhigh();
- sdalow();
+	SENDBIT( 0x80 )
+	SENDBIT( 0x40 )
+	SENDBIT( 0x20 )
+	SENDBIT( 0x10 )
+	SENDBIT( 0x08 )
+	SENDBIT( 0x04 )
+	SENDBIT( 0x02 )
+	SENDBIT( 0x01 )
+
+	// release sda for the ack
+	SDAHIGH;
+	WAIT;
+	SCLHIGH;
+	WAIT;
+	int nack = READSDA;
+	SCLLOW;
+	return nack;
 }
 
-void _sendstop()
+// ack 0 for more bytes, 1 on the last one
+static int softi2c_readbyte( int ack , int wait )
 {
-  
-  if (sda == 1) 
-  {
-    if (!scl) sdalow(); else 
-		{
-		#ifdef i2cdebug
-		printf("stop: error");
-		#endif
-		}
-  }
-  if (scl == 0) sclhigh();
-  else {
-		#ifdef i2cdebug
-		printf("stop: scl high");
-		#endif
-		}
-  sdahigh();
- 
+	int value = 0;
+	SDAHIGH;
+	READBIT( 0x80 )
+	READBIT( 0x40 )
+	READBIT( 0x20 )
+	READBIT( 0x10 )
+	READBIT( 0x08 )
+	READBIT( 0x04 )
+	READBIT( 0x02 )
+	READBIT( 0x01 )
+
+	if ( ack ) SDAHIGH; else SDALOW;
+	WAIT;
+	SCLHIGH;
+	WAIT;
+	SCLLOW;
+	return value;
 }
 
-
-
-int _sendbyte( int value )
+// start, device address and register, then a restart for reading
+// a nack ends the transfer
+static int softi2c_header( int device_address , int register_address , int read , int wait )
 {
-int i;
- if (scl == 1) 
- {
-  scllow();
- }
- 
- for ( i = 7; i >= 0 ;i--)
- {
- if ((value >> i)&1) 
- {
-  sdahigh();
- }
- else 
- {
-  sdalow();
- }
- //sclhigh();
- //scllow();
- sclhighlow();
- }
- 
- if (!sda) sdahigh(); // release the line
- //get ack
-
- sclhigh();
-// skip ack since it is not used here
- uint8_t ack;// = _readsda();
-	#ifdef i2cdebug
-  if (ack)
+	softi2c_start( wait );
+	if ( softi2c_sendbyte( device_address << 1 , wait ) ) goto error;
+	if ( softi2c_sendbyte( register_address , wait ) ) goto error;
+	if ( read )
 	{
-	if (debug) Serial.println("NOT RECEIVED"); 
+		softi2c_restart( wait );
+		if ( softi2c_sendbyte( ( device_address << 1 ) + 1 , wait ) ) goto error;
 	}
-	#endif
- scllow();
-return ack; 
-}
+	return 1;
 
-int _readbyte(int ack)  //ACK 1 single byte ACK 0 multiple bytes
-{
- uint8_t data=0;
-#ifdef i2cdebug
- if (scl == 1)
-	{	
-	printf("read: scl high");
-	}
-#endif
- if ( sda == 0) 
- {
-   sdahigh();
- }
- if(!sdaout) setoutput();
- int i;
- for( i = 7; i>=0;i--)
- {
-  sclhigh(); 
- if (_readsda() ) data|=(1<<i);
-  scllow();
- }
-
-if (ack)  
-{
-  sdahigh();
-} 
-else 
-{
-  sdalow();
-}
-  sclhigh();
-  scllow();
-if (sda) sdalow(); 
-
-return data;
+error:
+	softi2c_stop( wait );
+	liberror++;
+	return 0;
 }
 
 
 int softi2c_write( int device_address , int address, int value)
 {
- _sendstart();
- _sendbyte((device_address<<1));
- _sendbyte(address);
-  uint8_t ack = _sendbyte(value);
-  _sendstop();
-  return ack;
+	int wait = softi2c_wait;
+	if ( !softi2c_header( device_address , address , 0 , wait ) ) return 0;
+	int nack = softi2c_sendbyte( value , wait );
+	softi2c_stop( wait );
+	return !nack;
 }
 
 
 int softi2c_read(int device_address , int register_address)  
 {
- _sendstart();
- _sendbyte((device_address<<1));
- _sendbyte(register_address);
- _restart(); 
- _sendbyte((device_address<<1) + 1);
- uint8_t x = _readbyte(1); 
- _sendstop();
- return x; 
+	uint8_t data = 0;
+	softi2c_readdata( device_address , register_address , &data , 1 );
+	return data;
 }
 
 
-void softi2c_writedata(int device_address ,int register_address , int *data, int size ) 
+int softi2c_writedata(int device_address ,int register_address , uint8_t *data, int size ) 
 {
-	int index = 0;
- _sendstart();
- _sendbyte(device_address<<1);
- _sendbyte(register_address);
-  
-  _sendstop();
-
-	while(index<size)
+	int wait = softi2c_wait;
+	if ( !softi2c_header( device_address , register_address , 0 , wait ) ) return 0;
+	for ( int i = 0 ; i < size ; i++ )
 	{
-	_sendbyte(data[index]);
-	index++;	
+		if ( softi2c_sendbyte( data[i] , wait ) )
+		{
+			softi2c_stop( wait );
+			liberror++;
+			return 0;
+		}
 	}
- _sendstop();
-
+	softi2c_stop( wait );
+	return 1;
 }
 
 
-void softi2c_readdata(int device_address ,int register_address , int *data, int size ) 
+int softi2c_readdata(int device_address ,int register_address , uint8_t *data, int size ) 
 {
-	int index = 0;
- _sendstart();
- _sendbyte(device_address<<1);
- _sendbyte(register_address);
- _restart();
- _sendbyte( (device_address<<1) + 1);
-	while(index<size-1)
+	int wait = softi2c_wait;
+	if ( !softi2c_header( device_address , register_address , 1 , wait ) ) return 0;
+	for ( int i = 0 ; i < size - 1 ; i++ )
 	{
-	data[index] = _readbyte(0);
-	index++;	
+		data[i] = softi2c_readbyte( 0 , wait );
 	}
-  data[index] = _readbyte(1);
- _sendstop();
- 
+	data[size - 1] = softi2c_readbyte( 1 , wait );
+	softi2c_stop( wait );
+	return 1;
 }
 
+#pragma pop
+
+
+// index into softi2c_waits, returns 0 past the slowest
+int softi2c_setspeed( int speed )
+{
+	if ( speed >= (int) sizeof( softi2c_waits ) ) return 0;
+	softi2c_wait = softi2c_waits[speed];
+	return 1;
+}
 
 
 void softi2c_init()
@@ -383,7 +248,7 @@ void softi2c_init()
     GPIO_InitStructure.GPIO_OType = GPIO_OType_OD;
     GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
     GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
-    GPIO_Init(SOFTI2C_SCLPORT, &GPIO_InitStructure);
+    GPIO_Init(SOFTI2C_SDAPORT, &GPIO_InitStructure);
 
     // some boards have no SCL pullup, we drive SCL pullup for better speed on those
     // the factory firmware does this too, so it must be ok
@@ -392,22 +257,10 @@ void softi2c_init()
     #endif
 
     GPIO_InitStructure.GPIO_Pin = SOFTI2C_SCLPIN;
-    GPIO_Init(SOFTI2C_SDAPORT, &GPIO_InitStructure);
-
-
-    sdainit.GPIO_Pin = SOFTI2C_SDAPIN;
-    sdainit.GPIO_Mode = GPIO_Mode_IN;
-    sdainit.GPIO_OType = GPIO_OType_OD;
-    sdainit.GPIO_PuPd = GPIO_PuPd_UP;
-    sdainit.GPIO_Speed = GPIO_Speed_50MHz;
-
-    sdaout = 1;
-    sda = 0;
-    scl = 0;
-
+    GPIO_Init(SOFTI2C_SCLPORT, &GPIO_InitStructure);
 
-    sdahigh();
-    sclhigh();
+    SDAHIGH;
+    SCLHIGH;
 
 }
 
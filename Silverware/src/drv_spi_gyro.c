@@ -0,0 +1,224 @@
+
+
+#include "project.h"
+#include "drv_spi_gyro.h"
+#include "drv_time.h"
+#include "config.h"
+
+#ifdef USE_SPI_GYRO
+
+// pin numbers from hardware.h, all on port A
+#define SPI_GYRO_MOSI_PIN ( 1 << SPI_GYRO_MOSI_PA )
+#define SPI_GYRO_MOSI_PORT GPIOA
+#define SPI_GYRO_MISO_PIN ( 1 << SPI_GYRO_MISO_PA )
+#define SPI_GYRO_MISO_PORT GPIOA
+#define SPI_GYRO_CLK_PIN ( 1 << SPI_GYRO_CLK_PA )
+#define SPI_GYRO_CLK_PORT GPIOA
+#define SPI_GYRO_SS_PIN ( 1 << SPI_GYRO_SS_PA )
+#define SPI_GYRO_SS_PORT GPIOA
+
+// BATTERYPIN is a cast expression the preprocessor can not check,
+// a negative array size stops the build if a gyro pin is the battery pin ( port A on all targets )
+extern char spi_gyro_pin_is_battery_pin[ ( ( SPI_GYRO_MOSI_PIN | SPI_GYRO_MISO_PIN | SPI_GYRO_CLK_PIN | SPI_GYRO_SS_PIN ) & BATTERYPIN ) ? -1 : 1 ];
+
+// same for the radio, led and rgb led pins, on any port
+// the port pointers are not constant in a compare, the base addresses are
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOF
+#define GPIOA GPIOA_BASE
+#define GPIOB GPIOB_BASE
+#define GPIOC GPIOC_BASE
+#define GPIOF GPIOF_BASE
+
+#define SPI_GYRO_SHARES( port , pin ) ( ( port ) == GPIOA && ( ( pin ) & ( SPI_GYRO_MOSI_PIN | SPI_GYRO_MISO_PIN | SPI_GYRO_CLK_PIN | SPI_GYRO_SS_PIN ) ) )
+
+#ifndef SOFTSPI_NONE
+extern char spi_gyro_pin_is_radio_pin[ ( SPI_GYRO_SHARES( SPI_MOSI_PORT , SPI_MOSI_PIN ) ||
+	SPI_GYRO_SHARES( SPI_CLK_PORT , SPI_CLK_PIN ) || SPI_GYRO_SHARES( SPI_SS_PORT , SPI_SS_PIN )
+#ifdef SOFTSPI_4WIRE
+	|| SPI_GYRO_SHARES( SPI_MISO_PORT , SPI_MISO_PIN )
+#endif
+	) ? -1 : 1 ];
+#endif
+
+#if LED_NUMBER > 0
+extern char spi_gyro_pin_is_led1_pin[ SPI_GYRO_SHARES( LED1PORT , LED1PIN ) ? -1 : 1 ];
+#endif
+#if LED_NUMBER > 1
+extern char spi_gyro_pin_is_led2_pin[ SPI_GYRO_SHARES( LED2PORT , LED2PIN ) ? -1 : 1 ];
+#endif
+#if LED_NUMBER > 2
+extern char spi_gyro_pin_is_led3_pin[ SPI_GYRO_SHARES( LED3PORT , LED3PIN ) ? -1 : 1 ];
+#endif
+#if LED_NUMBER > 3
+extern char spi_gyro_pin_is_led4_pin[ SPI_GYRO_SHARES( LED4PORT , LED4PIN ) ? -1 : 1 ];
+#endif
+
+#if RGB_LED_NUMBER > 0
+extern char spi_gyro_pin_is_rgb_pin[ SPI_GYRO_SHARES( RGB_PORT , RGB_PIN ) ? -1 : 1 ];
+#endif
+
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOF
+#define GPIOA ((GPIO_TypeDef *) GPIOA_BASE)
+#define GPIOB ((GPIO_TypeDef *) GPIOB_BASE)
+#define GPIOC ((GPIO_TypeDef *) GPIOC_BASE)
+#define GPIOF ((GPIO_TypeDef *) GPIOF_BASE)
+
+// mpu6500 family: spi mode 0 or 3, 1Mhz for the configuration registers,
+// 20Mhz for the sensor and fifo registers
+// writes and single register reads are slowed down, bursts run at full speed
+
+void spi_gyro_init(void)
+{    
+	GPIO_InitTypeDef  GPIO_InitStructure;
+	
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_OUT;
+	GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+	GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+
+	GPIO_InitStructure.GPIO_Pin = SPI_GYRO_MOSI_PIN;
+	GPIO_Init(SPI_GYRO_MOSI_PORT, &GPIO_InitStructure);
+	
+	GPIO_InitStructure.GPIO_Pin = SPI_GYRO_CLK_PIN;
+	GPIO_Init(SPI_GYRO_CLK_PORT, &GPIO_InitStructure);
+	
+	GPIO_InitStructure.GPIO_Pin = SPI_GYRO_SS_PIN;
+	GPIO_Init(SPI_GYRO_SS_PORT, &GPIO_InitStructure);
+	
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN;
+	GPIO_InitStructure.GPIO_Pin = SPI_GYRO_MISO_PIN;
+	GPIO_Init(SPI_GYRO_MISO_PORT, &GPIO_InitStructure);
+	
+	SPI_GYRO_CLK_PORT->BRR = SPI_GYRO_CLK_PIN;
+	SPI_GYRO_SS_PORT->BSRR = SPI_GYRO_SS_PIN;
+}
+
+
+#define gpioset( port , pin) port->BSRR = pin
+#define gpioreset( port , pin) port->BRR = pin
+
+#define MOSIHIGH gpioset( SPI_GYRO_MOSI_PORT, SPI_GYRO_MOSI_PIN)
+#define MOSILOW gpioreset( SPI_GYRO_MOSI_PORT, SPI_GYRO_MOSI_PIN)
+#define SCKHIGH gpioset( SPI_GYRO_CLK_PORT, SPI_GYRO_CLK_PIN)
+#define SCKLOW gpioreset( SPI_GYRO_CLK_PORT, SPI_GYRO_CLK_PIN)
+#define CSON gpioreset( SPI_GYRO_SS_PORT, SPI_GYRO_SS_PIN)
+#define CSOFF gpioset( SPI_GYRO_SS_PORT, SPI_GYRO_SS_PIN)
+
+#define READMISO (SPI_GYRO_MISO_PORT->IDR & SPI_GYRO_MISO_PIN)
+
+#pragma push
+
+#pragma Otime
+#pragma O2
+
+// under 1Mhz clock
+static int spi_gyro_slowbyte( int data)
+{
+	int recv = 0;
+	for ( int i = 7 ; i >= 0 ; i--)
+	{
+		recv = recv<<1;
+		if ( data & (1<<7) ) 
+		{
+			MOSIHIGH;
+		}
+		else 
+		{
+			MOSILOW;
+		}
+		data = data<<1;
+		delay(1);
+		SCKHIGH;
+		delay(1);
+		if ( READMISO ) recv = recv|1;
+		SCKLOW;
+	}
+	return recv;
+}
+
+static void spi_gyro_sendbyte( int data)
+{
+	for ( int i = 7 ; i >= 0 ; i--)
+	{
+		if ( (data>>i)&1 ) 
+		{
+			MOSIHIGH;
+		}
+		else 
+		{
+			MOSILOW;
+		}
+		SCKHIGH;
+		SCKLOW;
+	}
+}
+
+static int spi_gyro_recvbyte( void)
+{
+	int recv = 0;
+	MOSILOW;
+	for ( int i = 7 ; i >= 0 ; i--)
+	{
+		recv = recv<<1;
+		SCKHIGH;
+		if ( READMISO ) recv = recv|1;
+		SCKLOW;
+	}
+	return recv;
+}
+
+
+void spi_gyro_writereg( int reg , int data)
+{
+	CSON;
+	spi_gyro_slowbyte( reg & 0x7F );
+	spi_gyro_slowbyte( data );
+	CSOFF;
+	delay(1);
+}
+
+int spi_gyro_readreg( int reg )
+{
+	CSON;
+	spi_gyro_slowbyte( reg | 0x80 );
+	int data = spi_gyro_slowbyte( 0 );
+	CSOFF;
+	return data;
+}
+
+// sensor registers only
+int spi_gyro_readdata( int reg , uint8_t *data , int size )
+{
+	CSON;
+	spi_gyro_sendbyte( reg | 0x80 );
+	for ( int i = 0 ; i < size ; i++ )
+	{
+		data[i] = spi_gyro_recvbyte();
+	}
+	CSOFF;
+	return 1;
+}
+
+// burst from FIFO_R_W, the address does not increment
+int spi_gyro_readfifo( uint8_t *data , int size )
+{
+	CSON;
+	spi_gyro_sendbyte( 116 | 0x80 );
+	for ( int i = 0 ; i < size ; i++ )
+	{
+		data[i] = spi_gyro_recvbyte();
+	}
+	CSOFF;
+	return 1;
+}
+
+#pragma pop
+
+#endif
+
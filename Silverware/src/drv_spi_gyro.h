@@ -0,0 +1,12 @@
+
+// soft spi for the spi gyro ( USE_SPI_GYRO )
+// own pins and chip select, the radio spi is not shared
+
+#include <inttypes.h>
+
+void spi_gyro_init( void);
+void spi_gyro_writereg( int reg , int data);
+int spi_gyro_readreg( int reg );
+int spi_gyro_readdata( int reg , uint8_t *data , int size );
+int spi_gyro_readfifo( uint8_t *data , int size );
+
@@ -5,8 +5,6 @@
 
 void failloop( int val);
 
-unsigned long lastticks;
-unsigned long globalticks;
 volatile unsigned long systickcount = 0;
 
 
@@ -16,7 +14,77 @@ volatile unsigned long systickcount = 0;
 #endif
 
 
- // divider by 8 is enabled in this systick config                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                  
+#ifdef TIMEBASE_TIM2
+
+// 32 bit TIM2 counting uS, gettime() is a register read
+// the update interrupt ( every 71 minutes ) extends it to 64 bit
+
+volatile unsigned long time_overflow = 0;
+
+void time_init()
+{
+	TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+	
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+	
+	TIM_TimeBaseStructInit(&TIM_TimeBaseStructure);
+	TIM_TimeBaseStructure.TIM_Prescaler = ( SYS_CLOCK_FREQ_HZ / 1000000 ) - 1;
+	TIM_TimeBaseStructure.TIM_Period = 0xFFFFFFFF;
+	TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+	TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(TIM2, &TIM_TimeBaseStructure);
+	
+	// TIM_TimeBaseInit generates an update event to load the prescaler
+	TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
+	TIM_ITConfig(TIM2, TIM_IT_Update, ENABLE);
+	NVIC_SetPriority(TIM2_IRQn, 3);
+	NVIC_EnableIRQ(TIM2_IRQn);
+	
+	TIM_Cmd(TIM2, ENABLE);
+	
+	// SysTick is free, used as a core clock cycle counter
+	SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+void TIM2_IRQHandler(void)
+{
+	TIM2->SR = (uint16_t)~TIM_IT_Update;
+	time_overflow++;
+}
+
+// return time in uS from start ( micros())
+unsigned long gettime()
+{
+	return TIM2->CNT;
+}
+
+// 64 bit time in uS
+uint64_t gettime64()
+{
+	NVIC_DisableIRQ(TIM2_IRQn);
+	unsigned long high = time_overflow;
+	unsigned long low = TIM2->CNT;
+	// wrapped, not yet counted by the interrupt
+	if ( ( TIM2->SR & TIM_IT_Update ) && low < 0x80000000 ) high++;
+	NVIC_EnableIRQ(TIM2_IRQn);
+	
+	return ( (uint64_t) high << 32 ) | low;
+}
+
+// core clock cycles, 24 bit
+unsigned long getcycles()
+{
+	return SysTick_LOAD_RELOAD_Msk - SysTick->VAL;
+}
+
+#else
+
+unsigned long lastticks;
+unsigned long globalticks;
+
+ // divider by 8 is enabled in this systick config                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                  
 static __INLINE uint32_t SysTick_Config2(uint32_t ticks)
 { 
   if (ticks > SysTick_LOAD_RELOAD_Msk)  return (1);            /* Reload value impossible */
@@ -84,6 +152,25 @@ unsigned long gettime()
 {
 	return time_update();
 }
+
+// 64 bit time in uS, needs a call at least every 71 minutes
+uint64_t gettime64()
+{
+	static unsigned long high = 0;
+	static unsigned long last = 0;
+	unsigned long time = time_update();
+	if ( time < last ) high++;
+	last = time;
+	return ( (uint64_t) high << 32 ) | time;
+}
+
+// core clock cycles, 24 bit, uS resolution with this time base
+unsigned long getcycles()
+{
+	return ( time_update() * ( SYS_CLOCK_FREQ_HZ / 1000000 ) ) & CYCLES_MASK;
+}
+
+#endif
 #ifdef ENABLE_OVERCLOCK
 // delay in uS
 void delay(uint32_t data)
@@ -2,6 +2,11 @@
 
 void time_init(void);
 unsigned long gettime(void);
+uint64_t gettime64(void);
+unsigned long getcycles(void);
+
+// getcycles() differences wrap at 24 bit
+#define CYCLES_MASK 0xFFFFFF
 
 void delay(uint32_t data);
 
@@ -0,0 +1,113 @@
+// loop overrun and fault record
+// a ring of the last loop stage start times in ram, written to flash
+// with the failloop code, loop time, rx state and for a hard fault the
+// pc / lr from the exception frame
+// dump the page with an st-link and decode it with fault_decode.py:
+// st-flash read fault.bin 0x08007800 1024
+
+#include "project.h"
+#include "config.h"
+#include "drv_time.h"
+#include "fault_record.h"
+
+#ifdef FAULT_RECORD
+
+void failloop( int val);
+
+// word layout, fault_decode.py reads the same
+typedef struct fault_record
+{
+	unsigned long magic;
+	unsigned long reason;
+	unsigned long time;
+	float looptime;
+	long liberror;
+	long rxmode;
+	long failsafe;
+	unsigned long pc;
+	unsigned long lr;
+	unsigned long xpsr;
+	unsigned long ring_next;
+	// uS time << 8 | stage
+	unsigned long ring[FAULT_RING];
+	unsigned long checksum;
+} fault_record_type;
+
+static fault_record_type fault;
+
+void fault_stage( int stage )
+{
+	fault.ring[fault.ring_next] = ( gettime() << 8 ) | stage;
+	fault.ring_next = ( fault.ring_next + 1 ) & ( FAULT_RING - 1 );
+}
+
+void fault_record_save( int reason )
+{
+	extern float looptime;
+	extern int liberror;
+	extern int rxmode;
+	extern int failsafe;
+	static int saved = 0;
+
+	// once, a flash error must not come back here
+	if ( saved ) return;
+	saved = 1;
+
+	fault.magic = FAULT_RECORD_MAGIC;
+	fault.reason = reason;
+	fault.time = gettime();
+	fault.looptime = looptime;
+	fault.liberror = liberror;
+	fault.rxmode = rxmode;
+	fault.failsafe = failsafe;
+
+	unsigned long * words = (unsigned long *) &fault;
+	const int count = sizeof( fault ) / 4;
+	unsigned long sum = 0;
+	for ( int i = 0 ; i < count - 1 ; i++ ) sum += words[i];
+	fault.checksum = sum;
+
+	FLASH_Unlock();
+	FLASH_ClearFlag( FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR );
+	if ( FLASH_ErasePage( FAULT_RECORD_ADDR ) == FLASH_COMPLETE )
+	{
+		for ( int i = 0 ; i < count ; i++ )
+		{
+			if ( FLASH_ProgramWord( FAULT_RECORD_ADDR + i * 4 , words[i] ) != FLASH_COMPLETE ) break;
+		}
+	}
+	FLASH_Lock();
+}
+
+// exception frame: r0 r1 r2 r3 r12 lr pc xpsr
+void fault_hardfault( unsigned long * frame )
+{
+	fault.lr = frame[5];
+	fault.pc = frame[6];
+	fault.xpsr = frame[7];
+	fault_record_save( 5 );
+	failloop(5);
+}
+
+// the handler passes the stack pointer at the fault ( main stack, no rtos )
+#if defined(__CC_ARM)
+__asm void HardFault_Handler(void)
+{
+	IMPORT fault_hardfault
+	MRS R0, MSP
+	LDR R1, =fault_hardfault
+	BX R1
+}
+#else
+__attribute__((naked)) void HardFault_Handler(void)
+{
+	__asm volatile(
+		"mrs r0, msp \n"
+		"ldr r1, =fault_hardfault \n"
+		"bx r1 \n"
+		".ltorg \n"
+	);
+}
+#endif
+
+#endif
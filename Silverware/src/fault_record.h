@@ -0,0 +1,25 @@
+// loop overrun and fault record ( FAULT_RECORD in config.h )
+// the last loop stages and some state are kept in ram and written
+// to a flash page before the failloop, read back with fault_decode.py
+
+// loop stages
+#define FAULT_LOOP 0
+#define FAULT_SIXAXIS 1
+#define FAULT_CONTROL 2
+#define FAULT_IMU 3
+#define FAULT_BATTERY 4
+#define FAULT_RX 5
+#define FAULT_WAIT 6
+
+// page below the settings page ( drv_fmc1.c )
+#define FAULT_RECORD_ADDR 0x08007800
+#define FAULT_RECORD_MAGIC 0x46524543
+#define FAULT_RING 16
+
+#ifdef FAULT_RECORD
+void fault_stage( int stage );
+void fault_record_save( int reason );
+#define FAULT_STAGE( stage ) fault_stage( stage )
+#else
+#define FAULT_STAGE( stage )
+#endif
@@ -16,14 +16,8 @@ extern "C" float lpfcalc( float sampleperiod , float filtertime);
 extern "C" float lpfcalc_hz(float sampleperiod, float filterhz);
 extern "C" void lpf( float *out, float in , float coeff);
 
-static float alpha = 0.5;
 extern float looptime;
 
-void lpf_coeff()
-{
- alpha = FILTERCALC( looptime , (1.0f/SOFT_LPF_1ST_PASS1) );       
-}
-
 
 class  filter_lpf1
 {
@@ -34,7 +28,7 @@ class  filter_lpf1
     {
       lpf_last = 0;   
     }
-     float step( float in)
+     float step( float in , float alpha )
      {
        lpf ( &lpf_last , in , alpha); 
          
@@ -42,7 +36,7 @@ class  filter_lpf1
      }
 };
 
-filter_lpf1 filter[3];
+typedef filter_lpf1 filter_pass1;
 #endif
 
 
@@ -52,14 +46,8 @@ extern "C" float lpfcalc( float sampleperiod , float filtertime);
 extern "C" float lpfcalc_hz(float sampleperiod, float filterhz);
 extern "C" void lpf( float *out, float in , float coeff);
 
-static float alpha2 = 0.5;
 extern float looptime;
 
-void lpf_coeff_pass2()
-{
- alpha2 = FILTERCALC( looptime , (1.0f/SOFT_LPF_1ST_PASS2) );       
-}
-
 
 class  filter_lpf2
 {
@@ -70,15 +58,15 @@ class  filter_lpf2
     {
       lpf_last = 0;   
     }
-     float step( float in)
+     float step( float in , float alpha )
      {
-       lpf ( &lpf_last , in , alpha2); 
+       lpf ( &lpf_last , in , alpha); 
          
        return lpf_last;
      }
 };
 
-filter_lpf2 filter2[3];
+typedef filter_lpf2 filter_pass2;
 #endif
 
 
@@ -90,11 +78,17 @@ class  filter_kalman
     private:
         float x_est_last ;
         float P_last ; 
+        float K;
+        int warmup;
         float Q;
         float R;
     public:
         filter_kalman()
         {
+            x_est_last = 0;
+            P_last = 0;
+            K = 0;
+            warmup = KALMAN_WARMUP;
             Q = 0.02; 
             R = 0.1;
 
@@ -105,23 +99,29 @@ class  filter_kalman
         }
         float  step( float in )   
         {    
+            // the gain does not depend on the input, once P stops
+            // changing it is constant and the division is skipped
+            if ( warmup )
+            {
+                float P_temp = P_last + Q; 
+                K = P_temp * (1.0f/(P_temp + R));
+                float P = (1- K) * P_temp; 
+                if ( P == P_last ) warmup = 0;
+                else warmup--;
+                P_last = P;
+            }
 
             //do a prediction 
             float x_temp_est = x_est_last; 
-            float P_temp = P_last + Q; 
-
-            float K = P_temp * (1.0f/(P_temp + R));
             float x_est = x_temp_est + K * (in - x_temp_est);  
-            float P = (1- K) * P_temp; 
            
             //update our last's 
-            P_last= P; 
             x_est_last = x_est; 
 
             return x_est;
         }
 };       
-filter_kalman filter[3];       
+typedef filter_kalman filter_pass1;
 #endif
 
 #if defined KALMAN_GYRO && defined GYRO_FILTER_PASS2
@@ -131,11 +131,17 @@ class  filter_kalman2
     private:
         float x_est_last ;
         float P_last ; 
+        float K;
+        int warmup;
         float Q;
         float R;
     public:
         filter_kalman2()
         {
+            x_est_last = 0;
+            P_last = 0;
+            K = 0;
+            warmup = KALMAN_WARMUP;
             Q = 0.02; 
             R = 0.1;
 
@@ -145,57 +151,115 @@ class  filter_kalman2
         }
         float  step( float in )   
         {    
+            // the gain does not depend on the input, once P stops
+            // changing it is constant and the division is skipped
+            if ( warmup )
+            {
+                float P_temp = P_last + Q; 
+                K = P_temp * (1.0f/(P_temp + R));
+                float P = (1- K) * P_temp; 
+                if ( P == P_last ) warmup = 0;
+                else warmup--;
+                P_last = P;
+            }
 
             //do a prediction 
             float x_temp_est = x_est_last; 
-            float P_temp = P_last + Q; 
-
-            float K = P_temp * (1.0f/(P_temp + R));
             float x_est = x_temp_est + K * (in - x_temp_est);  
-            float P = (1- K) * P_temp; 
            
             //update our last's 
-            P_last= P; 
             x_est_last = x_est; 
 
             return x_est;
         }
 };       
-filter_kalman2 filter2[3];       
+typedef filter_kalman2 filter_pass2;
 #endif
 
 
-extern "C" float lpffilter( float in,int num )
+// all gyro filter state in one place
+struct gyro_filter_state
+{
+	float alpha;
+	float alpha2;
+#ifndef SOFT_LPF1_NONE
+	filter_pass1 filter[3];
+#endif
+#ifndef SOFT_LPF2_NONE
+	filter_pass2 filter2[3];
+#endif
+	gyro_filter_state()
+	{
+		alpha = 0.5;
+		alpha2 = 0.5;
+	}
+};
+
+gyro_filter_state gyro_filters;
+
+
+extern "C" RAMFUNC float lpffilter( float in,int num )
 {
 	#ifdef SOFT_LPF1_NONE
 	return in;
 	#else
     
     #ifdef SOFT_LPF_1ST_PASS1
-    if ( num == 0 ) lpf_coeff();
+    if ( num == 0 ) gyro_filters.alpha = FILTERCALC( looptime , (1.0f/SOFT_LPF_1ST_PASS1) );
+	return gyro_filters.filter[num].step( in , gyro_filters.alpha );
+    #else
+	return gyro_filters.filter[num].step(in );   
     #endif
-       
-	return filter[num].step(in );   
 	#endif
 	
 }
 
 
 
- extern "C" float lpffilter2( float in,int num )
+ extern "C" RAMFUNC float lpffilter2( float in,int num )
 {
 	#ifdef SOFT_LPF2_NONE
 	return in;
 	#else
     
     #ifdef SOFT_LPF_1ST_PASS2
-    if ( num == 0 ) lpf_coeff_pass2();
+    if ( num == 0 ) gyro_filters.alpha2 = FILTERCALC( looptime , (1.0f/SOFT_LPF_1ST_PASS2) );
+	return gyro_filters.filter2[num].step( in , gyro_filters.alpha2 );
+    #else
+	return gyro_filters.filter2[num].step(in );   
     #endif
-      
-	return filter2[num].step(in );   
 	#endif
 	
 } 
+
+extern float gyro[3];
+
+// gyro in sensor units to rad/s, through the soft filters into gyro[]
+extern "C" RAMFUNC void gyro_filter( float gyronew[3] )
+{
+	for (int i = 0; i < 3; i++)
+	  {
+		  gyronew[i] = gyronew[i] * 0.061035156f * 0.017453292f;
+#ifndef SOFT_LPF_NONE
+			
+		#if defined (GYRO_FILTER_PASS2) && defined (GYRO_FILTER_PASS1)
+			gyro[i] = lpffilter(gyronew[i], i);
+			gyro[i] = lpffilter2(gyro[i], i);
+		#endif
+			
+		#if defined (GYRO_FILTER_PASS1) && !defined(GYRO_FILTER_PASS2)
+			gyro[i] = lpffilter(gyronew[i], i);
+		#endif
+			
+		#if defined (GYRO_FILTER_PASS2) && !defined(GYRO_FILTER_PASS1)
+			gyro[i] = lpffilter2(gyronew[i], i);
+		#endif
+#else
+		  gyro[i] = gyronew[i];
+#endif
+	  }
+}
+
 // 16Hz hpf filter for throttle compensation
 //High pass bessel filter order=1 alpha1=0.016 
 class  FilterBeHp1
@@ -218,12 +282,6 @@ class  FilterBeHp1
 		}
 };
 
-FilterBeHp1 throttlehpf1;
-
-extern "C" float throttlehpf( float in )
-{
-	return throttlehpf1.step(in );
-}
 
 
 
@@ -249,11 +307,23 @@ class  FilterSP
 		}
 };
 
-FilterSP spfilter[3];
+// throttle compensation and setpoint filter state
+struct control_filter_state
+{
+	FilterBeHp1 throttlehpf1;
+	FilterSP spfilter[3];
+};
+
+control_filter_state control_filters;
+
+extern "C" float throttlehpf( float in )
+{
+	return control_filters.throttlehpf1.step(in );
+}
 
 extern "C" float splpf( float in,int num )
 {
 
-	return spfilter[num].step(in );
+	return control_filters.spfilter[num].step(in );
 }
 
@@ -1,4 +1,6 @@
 
+#include <math.h>
+
 #include "project.h"
 #include "drv_fmc.h"
 #include "config.h"
@@ -131,12 +133,48 @@ if ( rx_bind_enable ){
 	}
 #endif
 
+#ifdef FAST_BOOT
+extern float gyrocal[3];
+extern float GEstG[3];
+
+// last good gyro bias and gravity vector for the next boot
+    writeword(57, FMC_HEADER);
+    for ( int i = 0 ; i < 3; i++)
+    {
+        fmc_write_float(58 + i, gyrocal[i]);
+        fmc_write_float(61 + i, GEstG[i]);
+    }
+#endif
+
     writeword(255, FMC_HEADER);
     
 	fmc_lock();
 }
 
 
+#ifdef FAST_BOOT
+// gyro counts the bias has to move before it is saved again
+#define GYROCAL_SAVE_LIMIT 2.0f
+
+// saves the refined gyro bias if it moved from the saved one
+// not over unsaved pid gesture changes, those are saved with the DDD gesture
+void flash_save_gyrocal( void)
+{
+	extern float gyrocal[3];
+	extern int pid_gestures_used;
+	if ( pid_gestures_used ) return;
+	for ( int i = 0 ; i < 3; i++)
+	{
+		if ( fabsf( gyrocal[i] - fmc_read_float(58 + i) ) > GYROCAL_SAVE_LIMIT )
+		{
+			flash_save();
+			return;
+		}
+	}
+}
+#endif
+
+
 
 void flash_load( void) {
 
@@ -224,6 +262,21 @@ extern int rx_bind_enable;
 	rx_bind_enable = fmc_read_float(56);
 #endif
 
+#ifdef FAST_BOOT
+	extern float gyrocal[3];
+	extern float GEstG[3];
+	extern int gyrocal_saved;
+	if ( FMC_HEADER == fmc_read(57) )
+	{
+		for ( int i = 0 ; i < 3; i++)
+		{
+			gyrocal[i] = fmc_read_float(58 + i);
+			GEstG[i] = fmc_read_float(61 + i);
+		}
+		gyrocal_saved = 1;
+	}
+#endif
+
     }
     else
     {
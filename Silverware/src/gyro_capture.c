@@ -0,0 +1,139 @@
+// raw gyro capture for noise analysis
+// records unfiltered gyro ( and motor ) samples at the loop rate into ram,
+// then streams them out as binary serial frames
+// use gyro_psd.py on the pc to plot the spectrum
+
+#include "project.h"
+#include "config.h"
+#include "defines.h"
+#include "drv_serial.h"
+#include <string.h>
+
+#ifdef GYRO_CAPTURE
+
+extern char aux[];
+
+// capture buffer, bytes
+#ifndef GYRO_CAPTURE_BUFFER
+#define GYRO_CAPTURE_BUFFER 1024
+#endif
+
+// values per data frame, after the 16 bit index
+#define CAPTURE_FRAME_VALUES ( ( SERIAL_FRAME_MAX - 2 ) / 2 )
+
+#define CAPTURE_IDLE 0
+#define CAPTURE_RECORD 1
+#define CAPTURE_HEADER 2
+#define CAPTURE_DATA 3
+
+#define CAPTURE_ROW ( ( GYRO_CAPTURE_AXES & 1 ) + ( ( GYRO_CAPTURE_AXES >> 1 ) & 1 ) + ( ( GYRO_CAPTURE_AXES >> 2 ) & 1 ) + ( ( GYRO_CAPTURE_AXES & 8 ) ? 4 : 0 ) )
+#define CAPTURE_VALUES ( ( GYRO_CAPTURE_BUFFER / 2 / CAPTURE_ROW ) * CAPTURE_ROW )
+
+int16_t capture_buffer[CAPTURE_VALUES];
+int capture_count = 0;
+int capture_sent = 0;
+int capture_state = CAPTURE_IDLE;
+int capture_lastaux = 1;
+
+int16_t capture_gyro_raw[3];
+int16_t capture_motor_raw[4];
+
+static int16_t capture_int16( float x )
+{
+	if ( x > 32767.0f ) return 32767;
+	if ( x < -32768.0f ) return -32768;
+	return (int16_t) x;
+}
+
+// gyro in sensor units ( 0.061 deg/s ), before the soft filters
+void capture_gyro( float gyronew[3] )
+{
+	for ( int i = 0 ; i < 3 ; i++ )
+		capture_gyro_raw[i] = capture_int16( gyronew[i] );
+}
+
+// motor command 0.0 - 1.0, stored as 0 - 10000
+void capture_motor( int motor , float value )
+{
+	capture_motor_raw[motor] = capture_int16( value * 10000.0f );
+}
+
+static void capture_record( void )
+{
+	int16_t * p = &capture_buffer[capture_count];
+
+	for ( int i = 0 ; i < 3 ; i++ )
+		if ( GYRO_CAPTURE_AXES & ( 1 << i ) ) *p++ = capture_gyro_raw[i];
+
+	if ( GYRO_CAPTURE_AXES & 8 )
+		for ( int i = 0 ; i < 4 ; i++ ) *p++ = capture_motor_raw[i];
+
+	capture_count += CAPTURE_ROW;
+}
+
+// called every loop after control()
+void capture_update( void )
+{
+	switch ( capture_state )
+	{
+		case CAPTURE_IDLE:
+			// start on the aux channel going on
+			if ( aux[GYRO_CAPTURE] && !capture_lastaux )
+			{
+				capture_count = 0;
+				capture_state = CAPTURE_RECORD;
+			}
+			break;
+
+		case CAPTURE_RECORD:
+			capture_record();
+			if ( capture_count >= CAPTURE_VALUES ) capture_state = CAPTURE_HEADER;
+			break;
+
+		case CAPTURE_HEADER:
+		{
+			// version, axes, loop time uS, samples
+			uint8_t header[6];
+			int samples = CAPTURE_VALUES / CAPTURE_ROW;
+			header[0] = 1;
+			header[1] = GYRO_CAPTURE_AXES;
+			header[2] = LOOPTIME & 0xff;
+			header[3] = LOOPTIME >> 8;
+			header[4] = samples & 0xff;
+			header[5] = samples >> 8;
+			if ( serial_frame_send( SERIAL_FRAME_CAPTURE_HEADER , header , 6 ) )
+			{
+				capture_sent = 0;
+				capture_state = CAPTURE_DATA;
+			}
+			break;
+		}
+
+		case CAPTURE_DATA:
+		{
+			// one frame per loop, retried if the serial buffer is full
+			uint8_t frame[2 + CAPTURE_FRAME_VALUES * 2];
+			int count = capture_count - capture_sent;
+			if ( count > CAPTURE_FRAME_VALUES ) count = CAPTURE_FRAME_VALUES;
+
+			frame[0] = capture_sent & 0xff;
+			frame[1] = capture_sent >> 8;
+			memcpy( &frame[2] , &capture_buffer[capture_sent] , count * 2 );
+
+			if ( serial_frame_send( SERIAL_FRAME_CAPTURE_DATA , frame , 2 + count * 2 ) )
+			{
+				capture_sent += count;
+				if ( capture_sent >= capture_count ) capture_state = CAPTURE_IDLE;
+			}
+			break;
+		}
+	}
+
+	capture_lastaux = aux[GYRO_CAPTURE];
+
+	// motors not updated when off
+	for ( int i = 0 ; i < 4 ; i++ )
+		capture_motor_raw[i] = 0;
+}
+
+#endif
@@ -29,8 +29,8 @@
 // 4 - Gyro not found - maybe i2c speed
 // 5 - clock , intterrupts , systick , gcc bad code , bad memory access (code issues like bad pointers)- this should not come up
 // 6 - loop time issue - if loop time exceeds 20mS
-// 7 - i2c error  - triggered by hardware i2c driver only
-// 8 - i2c error main loop  - triggered by hardware i2c driver only
+// 7 - i2c error at startup
+// 8 - i2c error rate main loop  - over I2C_FAIL_RATE of the gyro reads failing
 
 
 
@@ -45,16 +45,20 @@
 // I2C speed: fast = no delays 
 // slow1 = for i2c without pull-up resistors
 // slow2 = i2c failsafe speed
+// auto = fastest that passes a readback test at boot, slower on errors
 #define SOFTI2C_SPEED_FAST
 //#define SOFTI2C_SPEED_SLOW1
 //#define SOFTI2C_SPEED_SLOW2
+//#define SOFTI2C_SPEED_AUTO
 
 
 // hardware i2c speed ( 1000, 400 , 200 , 100Khz)
+// auto = fastest that passes a readback test at boot, slower on errors
 #define HW_I2C_SPEED_FAST2
 //#define HW_I2C_SPEED_FAST
 //#define HW_I2C_SPEED_SLOW1
 //#define HW_I2C_SPEED_SLOW2
+//#define HW_I2C_SPEED_AUTO
 
 
 // pins for hw i2c , select one only
@@ -63,6 +67,20 @@
 #define HW_I2C_PINS_PA910
 
 
+// spi gyro ( mpu6000 / mpu6500 / mpu9250 / icm-20602 / icm-20608 / icm-20689 )
+// soft spi on the pins below, the i2c driver is not used
+// runs the gyro at 8khz and reads the fifo every loop, averaged to one sample
+// GYRO_LOW_PASS_FILTER 0 or 7 for the 8khz rate
+//#define USE_SPI_GYRO
+
+// spi gyro pins, port A pin numbers ( -1 = not set )
+// not a motor, battery, radio, led, rgb led or swd pin, checked in config.h and drv_spi_gyro.c
+#define SPI_GYRO_MOSI_PA -1
+#define SPI_GYRO_MISO_PA -1
+#define SPI_GYRO_CLK_PA -1
+#define SPI_GYRO_SS_PA -1
+
+
 // disable the check for known gyro that causes the 4 times flash
 //#define DISABLE_GYRO_CHECK
 
@@ -113,9 +131,8 @@
 
 
 // RGB led type ws2812 - ws2813
-// numbers over 8 could decrease performance
+// driven by TIM1 + DMA, uses no loop time for the transfer
 #define RGB_LED_NUMBER 0
-#define RGB_LED_DMA
 
 
 // pin / port for the RGB led ( programming port ok )
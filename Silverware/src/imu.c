@@ -45,8 +45,15 @@ extern float accelcal[3];
 
 void imu_init(void)
 {
+#ifdef FAST_BOOT
+	extern int gyrocal_saved;
+	// GEstG was loaded from flash, a few samples are enough to correct it
+	int samples = gyrocal_saved ? 20 : 100;
+#else
+	int samples = 100;
+#endif
 	// init the gravity vector with accel values
-	for (int xx = 0; xx < 100; xx++)
+	for (int xx = 0; xx < samples; xx++)
 	  {
 		  sixaxis_read();
 
@@ -54,6 +61,9 @@ void imu_init(void)
 		    {
 			    lpf(&GEstG[x], accel[x]* ( 1/ 2048.0f) , 0.85);
 		    }
+#ifdef FAST_BOOT
+		  if ( !gyrocal_saved )
+#endif
 		  delay(1000);
 
 
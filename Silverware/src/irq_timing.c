@@ -0,0 +1,100 @@
+// interrupt timing
+// all interrupts masked: longest window per call site
+// interrupt handlers: longest run time and a log2 histogram each
+// TIM17 entry latency, a 4kHz interrupt whose counter runs at 1MHz,
+// so the counter at entry is the time since the update in uS
+// only sampled while a led pattern plays ( the interrupt is off with LED_MANUAL )
+// and a latency over the 250uS period wraps and reads low
+// results in irq_timing, the debug struct and the bayang telemetry
+
+#include "project.h"
+#include "config.h"
+#include "drv_time.h"
+#include "irq_timing.h"
+
+#ifdef IRQ_TIMING
+
+#ifdef DEBUG
+#include "debug.h"
+extern debug_type debug;
+#endif
+
+irq_timing_type irq_timing;
+
+static unsigned long irq_off_start;
+
+static int hist_bin( unsigned long value , int shift )
+{
+	value >>= shift;
+	int bin = 0;
+	while ( value && bin < IRQ_HIST_BINS - 1 )
+	{
+		value >>= 1;
+		bin++;
+	}
+	return bin;
+}
+
+// call right after __disable_irq()
+void irq_off_begin( void)
+{
+	irq_off_start = getcycles();
+}
+
+// call right before __enable_irq()
+void irq_off_end( int site )
+{
+	unsigned long time = ( getcycles() - irq_off_start ) & CYCLES_MASK;
+	if ( time > irq_timing.off_max[site] )
+	{
+		irq_timing.off_max[site] = time;
+#ifdef DEBUG
+		if ( time > debug.irq_off_max ) debug.irq_off_max = time;
+#endif
+	}
+}
+
+unsigned long isr_enter( void)
+{
+	return getcycles();
+}
+
+void isr_exit( int isr , unsigned long start )
+{
+	unsigned long time = ( getcycles() - start ) & CYCLES_MASK;
+	if ( time > irq_timing.isr_max[isr] ) irq_timing.isr_max[isr] = time;
+	unsigned short * bin = &irq_timing.isr_hist[isr][ hist_bin( time , IRQ_HIST_SHIFT ) ];
+	if ( *bin < 0xFFFF ) ( *bin )++;
+}
+
+void isr_latency( unsigned long us )
+{
+	if ( us > irq_timing.latency_max )
+	{
+		irq_timing.latency_max = us;
+#ifdef DEBUG
+		debug.isr_latency_max = us;
+#endif
+	}
+	unsigned short * bin = &irq_timing.latency_hist[ hist_bin( us , 1 ) ];
+	if ( *bin < 0xFFFF ) ( *bin )++;
+}
+
+// telemetry, uS capped at 255
+// 0 longest masked window, 1 longest TIM17 latency ( under 250uS ), 2 longest USART1 handler
+int irq_timing_byte( int item )
+{
+	unsigned long us = 0;
+	if ( item == 0 )
+	{
+		for ( int i = 0 ; i < IRQ_OFF_SITES ; i++ )
+			if ( irq_timing.off_max[i] > us ) us = irq_timing.off_max[i];
+		us /= SYS_CLOCK_FREQ_HZ / 1000000;
+	}
+	if ( item == 1 ) us = irq_timing.latency_max;
+	if ( item == 2 ) us = irq_timing.isr_max[ISR_USART1] / ( SYS_CLOCK_FREQ_HZ / 1000000 );
+	if ( us > 255 ) us = 255;
+	return us;
+}
+
+#endif
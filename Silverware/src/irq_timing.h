@@ -0,0 +1,51 @@
+// interrupt timing ( IRQ_TIMING in config.h )
+// longest window with all interrupts masked per call site,
+// run time of each interrupt handler and the entry latency of TIM17
+
+// call sites that mask all interrupts
+#define IRQ_OFF_DSHOT 0
+#define IRQ_OFF_SITES 1
+
+// interrupt handlers
+#define ISR_USART1 0
+#define ISR_DMA1_CH2_3 1
+#define ISR_DMA1_CH4_5 2
+#define ISR_EXTI4_15 3
+#define ISR_TIM17 4
+#define ISR_COUNT 5
+
+// log2 histograms, handler times from bin 0 under 64 cycles to bin 7 over 4096
+// latency from bin 0 under 2 uS to bin 7 over 128 uS
+#define IRQ_HIST_BINS 8
+#define IRQ_HIST_SHIFT 5
+
+typedef struct irq_timing
+{
+	// cycles
+	unsigned long off_max[IRQ_OFF_SITES];
+	unsigned long isr_max[ISR_COUNT];
+	unsigned short isr_hist[ISR_COUNT][IRQ_HIST_BINS];
+	// uS, TIM17 has the lowest priority so it waits for everything else
+	unsigned short latency_max;
+	unsigned short latency_hist[IRQ_HIST_BINS];
+} irq_timing_type;
+
+#ifdef IRQ_TIMING
+extern irq_timing_type irq_timing;
+
+void irq_off_begin( void);
+void irq_off_end( int site );
+unsigned long isr_enter( void);
+void isr_exit( int isr , unsigned long start );
+void isr_latency( unsigned long us );
+int irq_timing_byte( int item );
+
+#define ISR_ENTER() unsigned long isr_start = isr_enter()
+#define ISR_EXIT( isr ) isr_exit( isr , isr_start )
+#else
+#define irq_off_begin()
+#define irq_off_end( site )
+#define isr_latency( us )
+#define ISR_ENTER()
+#define ISR_EXIT( isr )
+#endif
@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "drv_time.h"
 #include "led.h"
 #include "config.h"
+#include "irq_timing.h"
 
 #define LEDALL 15
 
@@ -94,97 +95,146 @@ void ledoff( uint8_t val )
 #endif
 }
 
-void ledflash( uint32_t period , int duty )
+// led patterns, played by a TIM17 interrupt
+// the main loop only posts pattern changes
+
+// sequencer rate, 15 brightness slots per pwm period ( 267Hz )
+#define LED_TIMER_HZ 4000
+#define LED_TICKS_MS ( LED_TIMER_HZ / 1000 )
+#define LED_LEVELS 15
+
+typedef struct
+{
+	uint16_t time1;		// ms
+	uint16_t time2;		// ms
+	uint8_t level1;		// brightness 0 - 15
+	uint8_t level2;
+} led_pattern_t;
+
+// same order as the LED_ pattern numbers in led.h
+// flashes are off first, then on, like ledflash( period , duty ) used to be
+static const led_pattern_t led_patterns[] = 
+{
+	{ 1000 , 0 , 0 , 0 },											// LED_MANUAL ( not played )
+	{ 1000 , 0 , 0 , 0 },											// LED_OFF
+	{ 1000 , 0 , LED_BRIGHTNESS , 0 },				// LED_ON
+	{ 1000 , 0 , 0 , 0 },											// LED_STEADY ( level from led_pwm )
+	{ 250 , 250 , 0 , LED_LEVELS },						// LED_LOWBATT		500mS 8/16
+	{ 75 , 25 , 0 , LED_LEVELS },							// LED_BIND				100mS 12/16
+	{ 468 , 32 , 0 , LED_LEVELS },						// LED_FAILSAFE		500mS 15/16
+	{ 50 , 50 , 0 , LED_LEVELS },							// LED_COMMAND		100mS 8/16
+	{ 300 , 200 , 0 , LED_BRIGHTNESS },				// LED_BLINK_ON		leds on, blink off
+	{ 300 , 200 , LED_LEVELS , 0 },						// LED_BLINK_OFF	leds off, blink on
+};
+
+volatile int led_current = LED_MANUAL;
+volatile int led_remaining = 0;	// pattern cycles left, -1 = forever
+volatile int led_steady_level = 0;
+volatile int led_ticks = 0;
+volatile int led_phase = 0;
+int led_slot = 0;
+int led_state = 0;
+
+void led_init( void )
 {
 #if ( LED_NUMBER > 0 )	
-	if ( gettime() % period > (period*duty)>>4 )
-	{
-		ledon(LEDALL);
-	}
-	else
-	{
-		ledoff(LEDALL);
-	}
+	TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+	
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM17, ENABLE);
+	
+	TIM_TimeBaseStructInit(&TIM_TimeBaseStructure);
+	TIM_TimeBaseStructure.TIM_Prescaler = ( SYS_CLOCK_FREQ_HZ / 1000000 ) - 1;
+	TIM_TimeBaseStructure.TIM_Period = ( 1000000 / LED_TIMER_HZ ) - 1;
+	TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+	TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(TIM17, &TIM_TimeBaseStructure);
+	
+	NVIC_InitTypeDef NVIC_InitStructure;
+	// lowest priority, dma and serial go first
+	NVIC_InitStructure.NVIC_IRQChannel = TIM17_IRQn;
+	NVIC_InitStructure.NVIC_IRQChannelPriority = 3;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = DISABLE;
+	NVIC_Init(&NVIC_InitStructure);
+	
+	TIM_ClearITPendingBit(TIM17, TIM_IT_Update);
+	TIM_ITConfig(TIM17, TIM_IT_Update, ENABLE);
+	TIM_Cmd(TIM17, ENABLE);
 #endif	
 }
 
-
-int ledlevel = 0;
-
-uint8_t led_pwm2( uint8_t pwmval)
-{
-static int loopcount = 0;
-	
-ledlevel = pwmval;
-loopcount++;
-loopcount&=0xF;
-if ( ledlevel > loopcount )
+// start a pattern for count cycles ( -1 = forever ), restarts it if already playing
+void led_pattern_repeat( int pattern , int count )
 {
-ledon( 255);
+#if ( LED_NUMBER > 0 )		
+	NVIC_DisableIRQ(TIM17_IRQn);
+	led_current = pattern;
+	led_remaining = count;
+	led_ticks = 0;
+	led_phase = 0;
+	if ( pattern != LED_MANUAL ) NVIC_EnableIRQ(TIM17_IRQn);
+#endif	
 }
-else
+
+// play a pattern continuously, no change if already playing
+// LED_MANUAL stops the sequencer so ledon / ledoff can be used directly
+void led_pattern( int pattern )
 {
-ledoff( 255);
+	if ( pattern == led_current && led_remaining < 0 ) return;
+	led_pattern_repeat( pattern , -1 );
 }
-return ledlevel;
-}
-
-int ledlevel2 = 0;
-unsigned long lastledtime;
-float lastledbrightness = 0;
-
-//#define DEBUG
-
-#ifdef DEBUG
-int debug_led;
-#endif
-
-#include "util.h"
 
-// delta- sigma first order modulator.
-uint8_t led_pwm( uint8_t pwmval)
+// cycles left of a counted pattern, 0 when done
+int led_pattern_remaining( void )
 {
-	static float ds_integrator= 0;
-	unsigned int time = gettime();
-	unsigned int ledtime = time - lastledtime; 
-
-	lastledtime = time;
+	return led_remaining > 0 ? led_remaining : 0;
+}
 
+#if ( LED_NUMBER > 0 )	
+void TIM17_IRQHandler(void)
+{
+	ISR_ENTER();
+	// 4kHz interrupt, the counter runs at 1MHz and holds the uS since the update
+	// only sampled while a pattern plays, over 250uS ( one period ) it wraps
+	isr_latency( TIM17->CNT );
+	TIM17->SR = (uint16_t)~TIM_IT_Update;
 	
-	float desiredbrightness = pwmval*( 1.0f/ 15.0f);
-
-//	limitf( &lastledbrightness, 2);
-
-	limitf( &ds_integrator, 2);
+	const led_pattern_t * p = &led_patterns[ led_current ];
+	
+	int level = led_phase ? p->level2 : p->level1;
+	if ( led_current == LED_STEADY ) level = led_steady_level;
 	
-	ds_integrator += (desiredbrightness - lastledbrightness)*ledtime* ( 1.0f  /(float) LOOPTIME);
+	if ( ++led_slot >= LED_LEVELS ) led_slot = 0;
 	
-	if ( ds_integrator > 0.49f ) 
+	int on = level > led_slot;
+	if ( on != led_state )
+	{
+		led_state = on;
+		if ( on ) ledon( 255 );
+		else ledoff( 255 );
+	}
+
+	if ( ++led_ticks >= ( led_phase ? p->time2 : p->time1 ) * LED_TICKS_MS )
+	{
+		led_ticks = 0;
+		if ( led_phase || !p->time2 )
 		{
-		ledon( 255);
-			lastledbrightness = 1.0f;
-			#ifdef DEBUG
-			debug_led<<=1;
-			debug_led|=1;
-			#endif
+			led_phase = 0;
+			if ( led_remaining > 0 ) led_remaining--;
 		}
-		else
-		{
-		ledoff( 255);
-			lastledbrightness = 0;
-			#ifdef DEBUG
-			debug_led<<=1;
-			debug_led&=0xFFFFFFFE;
-			#endif
-		}	
-return 0;	
-}
-
-
-
-
+		else led_phase = 1;
+	}
 
+	ISR_EXIT( ISR_TIM17 );
+}
+#endif
 
+// steady brightness 0 - 15
+uint8_t led_pwm( uint8_t pwmval)
+{
+	led_steady_level = pwmval;
+	led_pattern( LED_STEADY );
+	return 0;	
+}
 
 
 
@@ -6,7 +6,23 @@
 void ledon( uint8_t val );
 void ledoff( uint8_t val );
 void ledset( int val );
-void ledflash( uint32_t period , int duty );
+
+// led patterns, led.c
+#define LED_MANUAL 0
+#define LED_OFF 1
+#define LED_ON 2
+#define LED_STEADY 3
+#define LED_LOWBATT 4
+#define LED_BIND 5
+#define LED_FAILSAFE 6
+#define LED_COMMAND 7
+#define LED_BLINK_ON 8
+#define LED_BLINK_OFF 9
+
+void led_init( void );
+void led_pattern( int pattern );
+void led_pattern_repeat( int pattern , int count );
+int led_pattern_remaining( void );
 
 void auxledon( uint8_t val );
 void auxledoff( uint8_t val );
@@ -95,6 +95,7 @@ THE SOFTWARE.
 #include "drv_serial.h"
 #include "rx.h"
 #include "drv_spi.h"
+#include "drv_spi_gyro.h"
 #include "control.h"
 #include "pid.h"
 #include "defines.h"
@@ -127,6 +128,19 @@ THE SOFTWARE.
 #include "debug.h"
 debug_type debug;
 #endif
+#include "irq_timing.h"
+#include "fault_record.h"
+#include "stack_check.h"
+
+// boot time breakdown in debug.boottime[] ( uS from time_init )
+#ifdef DEBUG
+#define BOOT_STAGE( stage ) debug.boottime[stage] = gettime()
+#else
+#define BOOT_STAGE( stage )
+#endif
+
+// gyro power up time before i2c_init()
+#define GYRO_WARMUP_TIME 100000
 
 
 
@@ -185,9 +199,11 @@ int flash_feature_3 = 0;
 // for led flash on gestures
 int ledcommand = 0;
 int ledblink = 0;
-unsigned long ledcommandtime = 0;
+int ledcommand_posted = 0;
+int ledblink_posted = 0;
 
 void failloop( int val);
+static void sensors_init( void);
 #ifdef USE_SERIAL_4WAY_BLHELI_INTERFACE
 volatile int switch_to_4way = 0;
 static void setup_4way_external_interrupt(void);
@@ -197,6 +213,9 @@ int random_seed = 0;
 /// Execution.
 int main(void)
 {
+#ifdef STACK_CHECK
+	stack_paint();
+#endif
 	
 	delay(1000);
 
@@ -207,6 +226,7 @@ clk_init();
 	
   gpio_init();	
   ledon(255);									//Turn on LED during boot so that if a delay is used as part of using programming pins for other functions, the FC does not appear inactive while programming times out
+  led_init();
 	spi_init();
 	
   time_init();
@@ -217,29 +237,14 @@ clk_init();
 #endif
 	
 	
-	delay(100000);
-		
-	i2c_init();	
-	
-	pwm_init();
-
-	pwm_set( MOTOR_BL , 0);
-	pwm_set( MOTOR_FL , 0);	 
-	pwm_set( MOTOR_FR , 0); 
-	pwm_set( MOTOR_BR , 0); 
-
-
-	sixaxis_init();
-	
-	if ( sixaxis_check() ) 
-	{
+#ifdef FAST_BOOT
+	// radio init and battery sampling run during the gyro power up time
+	unsigned long warmup_start = gettime();
+#else
+	delay(GYRO_WARMUP_TIME);
 		
-	}
-	else 
-	{
-        //gyro not found   
-		failloop(4);
-	}
+	sensors_init();
+#endif
 	
 	adc_init();
 //set always on channel to on
@@ -262,10 +267,19 @@ aux[CH_AUX1] = 1;
 	
 	rx_init();
 
+extern void rgb_init( void);
+#ifdef FAST_BOOT
+rgb_init();
+#endif
+	BOOT_STAGE( BOOT_RX );
 	
 int count = 0;
 	
+#ifdef FAST_BOOT
+while ( count < 16 || gettime() - warmup_start < GYRO_WARMUP_TIME )
+#else
 while ( count < 64 )
+#endif
 {
 	vbattfilt += adc_read(0);
 	delay(1000);
@@ -276,9 +290,14 @@ while ( count < 64 )
     random_seed =  *(int *)&vbattfilt ; 
     random_seed = random_seed&0xff;
 #endif
- vbattfilt = vbattfilt/64;	
+ vbattfilt = vbattfilt/count;	
 // startvref = startvref/64;
 
+#ifdef FAST_BOOT
+	sensors_init();
+#endif
+	BOOT_STAGE( BOOT_SENSORS );
+
 	
 #ifdef STOP_LOWBATTERY
 // infinite loop
@@ -287,10 +306,16 @@ if ( vbattfilt < (float) 3.3f) failloop(2);
 
 
 
+#ifdef FAST_BOOT
+	// full calibration only if there is no saved bias or the quad moves
+	if ( !gyro_cal_fast() )
+#endif
 	gyro_cal();
+	BOOT_STAGE( BOOT_GYROCAL );
 
-extern void rgb_init( void);
+#ifndef FAST_BOOT
 rgb_init();
+#endif
 
 #ifdef SERIAL_ENABLE
 serial_init();
@@ -299,6 +324,18 @@ serial_init();
 
 
 imu_init();
+	BOOT_STAGE( BOOT_IMU );
+
+#ifdef FAST_BOOT
+extern int gyrocal_saved;
+if ( !gyrocal_saved )
+{
+	// first boot, save the bias for the next one
+	extern void flash_save( void);
+	flash_save();
+	gyrocal_saved = 1;
+}
+#endif
 
 #ifdef FLASH_SAVE2
 // read accelerometer calibration values from option bytes ( 2* 8bit)
@@ -317,6 +354,7 @@ if ( liberror )
 
 
  lastlooptime = gettime();
+	BOOT_STAGE( BOOT_LOOP );
 
 
 //
@@ -333,6 +371,10 @@ if ( liberror )
 	{ 
 		// gettime() needs to be called at least once per second 
 		unsigned long time = gettime(); 
+#ifdef DEBUG
+		unsigned long loopcycles = getcycles();
+#endif
+		FAULT_STAGE( FAULT_LOOP );
 		looptime = ((uint32_t)( time - lastlooptime));
 		if ( looptime <= 0 ) looptime = 1;
 		looptime = looptime * 1e-6f;
@@ -348,21 +390,50 @@ if ( liberror )
 		#endif
 		lastlooptime = time;
 		
-		if ( liberror > 20) 
+		if ( i2c_error_rate > I2C_FAIL_RATE ) 
 		{
 			failloop(8);
 			// endless loop
 		}
 
+#ifdef DEBUG
+		// hot path times in uS, compare builds with and without RAM_HOT_PATH
+		unsigned long hottime = gettime();
+#endif
+
         // read gyro and accelerometer data	
+		FAULT_STAGE( FAULT_SIXAXIS );
 		sixaxis_read();
+
+#ifdef DEBUG
+		unsigned long hottime2 = gettime();
+		lpf ( &debug.time_sixaxis , hottime2 - hottime , 0.99f );
+#endif
 		
         // all flight calculations and motors
+		FAULT_STAGE( FAULT_CONTROL );
 		control();
 
+#ifdef DEBUG
+		lpf ( &debug.time_control , gettime() - hottime2 , 0.99f );
+#endif
+
+#ifdef GYRO_CAPTURE
+		extern void capture_update( void);
+		capture_update();
+#endif
+
+#ifdef NOISE_ANALYZER
+		// one spectrum bin per loop
+		extern void noise_update( void);
+		noise_update();
+#endif
+
         // attitude calculations for level mode 		
  		extern void imu_calc(void);		
+		FAULT_STAGE( FAULT_IMU );
 		imu_calc(); 
+		FAULT_STAGE( FAULT_BATTERY );
        
       
 // battery low logic
@@ -468,66 +539,67 @@ if( thrfilt > 0.1f )
 	 gestures( );
 	}
 
+#if defined(FAST_BOOT) && defined(ARMING)
+// save the refined gyro bias at disarm on the ground
+	static int last_armed_state = 0;
+	if ( last_armed_state && !armed_state && onground )
+	{
+		extern void flash_save_gyrocal( void);
+		flash_save_gyrocal();
+		// reset loop time
+		lastlooptime = gettime();
+	}
+	last_armed_state = armed_state;
+#endif
+
    
 
 
 if ( LED_NUMBER > 0)
 {
-// led flash logic	
+// led flash logic, patterns are played by the led timer	
     if ( lowbatt )
-        ledflash ( 500000 , 8);
+        led_pattern ( LED_LOWBATT );
     else
     {
         if ( rxmode == RXMODE_BIND)
         {// bind mode
-            ledflash ( 100000, 12);
+            led_pattern ( LED_BIND );
         }else
         {// non bind
             if ( failsafe) 
                 {
-                    ledflash ( 500000, 15);			
+                    led_pattern ( LED_FAILSAFE );			
                 }
             else 
             {  
                 int leds_on = !aux[LEDS_ON];
                 if (ledcommand)
                 {
-                    if (!ledcommandtime)
-                      ledcommandtime = gettime();
-                    if (gettime() - ledcommandtime > 500000)
+                    if (!ledcommand_posted)
+                    {
+                        // 5 flashes, 500mS
+                        led_pattern_repeat( LED_COMMAND , 5 );
+                        ledcommand_posted = 1;
+                    }
+                    else if ( !led_pattern_remaining() )
                     {
                         ledcommand = 0;
-                        ledcommandtime = 0;
+                        ledcommand_posted = 0;
                     }
-                    ledflash(100000, 8);
                 }
                 else if (ledblink)
                 {
-                    unsigned long time = gettime();
-                    if (!ledcommandtime)
-                    {
-                        ledcommandtime = time;
-                        if ( leds_on) ledoff(255);
-                        else ledon(255); 
-                    }
-                    if ( time - ledcommandtime > 500000)
-                    {
-                        ledblink--;
-                        ledcommandtime = 0;
-                    }
-                     if ( time - ledcommandtime > 300000)
-                    {
-                        if ( leds_on) ledon(255);
-                        else  ledoff(255);
-                    }
+                    // (re)start if a gesture changed the count
+                    if ( ledblink != ledblink_posted )
+                        led_pattern_repeat( leds_on ? LED_BLINK_ON : LED_BLINK_OFF , ledblink );
+                    ledblink = ledblink_posted = led_pattern_remaining();
                 }
                 else if ( leds_on )
                 {
-                    if ( LED_BRIGHTNESS != 15)	
-                    led_pwm(LED_BRIGHTNESS);
-                    else ledon(255);
+                    led_pattern ( LED_ON );
                 }
-                else ledoff(255);
+                else led_pattern ( LED_OFF );
             }
         } 		       
     }
@@ -539,11 +611,9 @@ if ( LED_NUMBER > 0)
 // RGB led control
 extern	void rgb_led_lvc( void);
 rgb_led_lvc( );
-#ifdef RGB_LED_DMA
 extern void rgb_dma_start();
 rgb_dma_start();
 #endif
-#endif
 
 
 #ifdef BUZZER_ENABLE	
@@ -576,6 +646,7 @@ rgb_dma_start();
 				switch_to_4way = 0;
 
 				NVIC_DisableIRQ(EXTI4_15_IRQn);
+				led_pattern( LED_MANUAL );
 				ledon(2);
 				esc4wayInit();
 				esc4wayProcess();
@@ -591,12 +662,26 @@ rgb_dma_start();
 		}
 #endif
 
+#ifdef OSD_LTM_PROTOCOL
+// osd telemetry frames
+extern void osdcycle( void);
+osdcycle();
+#endif
+
 // receiver function
+FAULT_STAGE( FAULT_RX );
 checkrx();
+FAULT_STAGE( FAULT_WAIT );
 
+#ifdef STACK_CHECK
+stack_check();
+#endif
 
 #ifdef DEBUG
 	debug.cpu_load = (gettime() - lastlooptime )*1e-3f;
+	// core cycles of the loop work, compare config variants
+	debug.loop_cycles = ( getcycles() - loopcycles ) & CYCLES_MASK;
+	if ( debug.loop_cycles > debug.loop_cycles_max ) debug.loop_cycles_max = debug.loop_cycles;
 #endif
 
 while ( (gettime() - time) < LOOPTIME );	
@@ -614,15 +699,23 @@ while ( (gettime() - time) < LOOPTIME );
 // 6 - loop time issue
 // 7 - i2c error 
 // 8 - i2c error main loop
+// 9 - rgb led dma still running at the dshot update
 
 
 void failloop( int val)
 {
+	led_pattern( LED_MANUAL );
 	for ( int i = 0 ; i <= 3 ; i++)
 	{
 		pwm_set( i ,0 );
 	}	
 
+#ifdef FAULT_RECORD
+	// loop time, i2c and dma errors, the hard fault saves itself with the pc
+	// not the startup checks, or 5 from a flash write error or the systick setup
+	if ( val >= 6 ) fault_record_save( val );
+#endif
+
 	while(1)
 	{
 		for ( int i = 0 ; i < val; i++)
@@ -638,10 +731,44 @@ void failloop( int val)
 }
 
 
+// i2c, motor outputs and gyro setup
+static void sensors_init( void)
+{
+#ifdef USE_SPI_GYRO
+	spi_gyro_init();
+#else
+	i2c_init();	
+#endif
+	
+	pwm_init();
+
+	pwm_set( MOTOR_BL , 0);
+	pwm_set( MOTOR_FL , 0);	 
+	pwm_set( MOTOR_FR , 0); 
+	pwm_set( MOTOR_BR , 0); 
+
+
+	sixaxis_init();
+	
+	if ( sixaxis_check() ) 
+	{
+		
+	}
+	else 
+	{
+        //gyro not found   
+		failloop(4);
+	}
+}
+
+
+#ifndef FAULT_RECORD
+// with FAULT_RECORD in fault_record.c, it saves the fault address
 void HardFault_Handler(void)
 {
 	failloop(5);
 }
+#endif
 void MemManage_Handler(void) 
 {
 	failloop(5);
@@ -672,6 +799,7 @@ static void setup_4way_external_interrupt(void)
 // start byte (0x2F) on PA14 at 38400 baud
 void EXTI4_15_IRQHandler(void)
 {
+	ISR_ENTER();
 	if( (EXTI->IMR & EXTI_IMR_MR14) && (EXTI->PR & EXTI_PR_PR14))
 	{
 #define IS_RX_HIGH (GPIOA->IDR & GPIO_Pin_14)
@@ -710,6 +838,8 @@ void EXTI4_15_IRQHandler(void)
 		// clear pending request
 		EXTI->PR |= EXTI_PR_PR14 ;
 	}
+
+	ISR_EXIT( ISR_EXTI4_15 );
 }
 #endif
 
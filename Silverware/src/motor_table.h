@@ -0,0 +1,16 @@
+// motor thrust table for MOTOR_CURVE_TABLE
+// replace with the output of replay/thrust_table.py for your motors
+// this one is linear, the same as MOTOR_CURVE_NONE
+
+// number of tables, 1 for all motors or 4, one per motor number
+#define MOTOR_TABLE_COUNT 1
+// points per table, evenly spaced thrust from 0 to 1
+#define MOTOR_TABLE_SIZE 17
+// battery voltage during the measurement, the output is scaled with it
+//#define MOTOR_TABLE_VOLTAGE 4.00
+
+static const float motor_table[MOTOR_TABLE_COUNT][MOTOR_TABLE_SIZE] =
+{
+	{ 0.0000f , 0.0625f , 0.1250f , 0.1875f , 0.2500f , 0.3125f , 0.3750f , 0.4375f , 0.5000f ,
+	  0.5625f , 0.6250f , 0.6875f , 0.7500f , 0.8125f , 0.8750f , 0.9375f , 1.0000f },
+};
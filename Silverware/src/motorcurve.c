@@ -2,7 +2,7 @@
 
 #ifdef BOLDCLASH_716MM_8K
 
-float motormap(float input)
+float motormap(float input, int motor)
 {
 	// this is a thrust to pwm function
 	//  float 0 to 1 input and output
@@ -24,7 +24,7 @@ float motormap(float input)
 
 #ifdef BOLDCLASH_716MM_24K
 
-float motormap(float input)
+float motormap(float input, int motor)
 {
 	// this is a thrust to pwm function
 	//  float 0 to 1 input and output
@@ -46,7 +46,7 @@ float motormap(float input)
 
 #ifdef MOTOR_CURVE_6MM_490HZ
 // the old map for 490Hz
-float motormap(float input)
+float motormap(float input, int motor)
 {
 	// this is a thrust to pwm function
 	//  float 0 to 1 input and output
@@ -69,7 +69,7 @@ float motormap(float input)
 
 
 #ifdef MOTOR_CURVE_6MM_H101_490HZ
-float motormap( float input)
+float motormap( float input, int motor)
 { 
 
 	// H101 thrust curve for normal thrust direction
@@ -88,7 +88,7 @@ return input;
 // 8k pwm is where the motor thrust is relatively linear for the H8 6mm motors
 // it's due to the motor inductance cancelling the nonlinearities.
 #ifdef MOTOR_CURVE_NONE
-float motormap(float input)
+float motormap(float input, int motor)
 {
 	return input;
 }
@@ -97,7 +97,7 @@ float motormap(float input)
 
 #ifdef MOTOR_CURVE_85MM_8KHZ
 // Hubsan 8.5mm 8khz pwm motor map
-float motormap(float input)
+float motormap(float input, int motor)
 {
 //      Hubsan 8.5mm motors and props 
 
@@ -116,7 +116,7 @@ float motormap(float input)
 
 #ifdef MOTOR_CURVE_85MM_8KHZ_OLD
 // Hubsan 8.5mm 8khz pwm motor map
-float motormap(float input)
+float motormap(float input, int motor)
 {
 //      Hubsan 8.5mm motors and props 
 
@@ -135,7 +135,7 @@ float motormap(float input)
 
 #ifdef MOTOR_CURVE_85MM_32KHZ
 // Hubsan 8.5mm 32khz pwm motor map
-float motormap(float input)
+float motormap(float input, int motor)
 {
 //      Hubsan 8.5mm motors and props 
 
@@ -151,3 +151,50 @@ float motormap(float input)
 }
 #endif
 
+
+
+#ifdef MOTOR_CURVE_TABLE
+// thrust to pwm from thrust stand measurements
+// motor_table.h is made by replay/thrust_table.py, one table or one per motor
+// with the test voltage in it, the output is scaled for the battery voltage
+#include "motor_table.h"
+
+extern float vbattfilt;
+
+static float motor_vscale = 1.0f;
+
+float motormap(float input, int motor)
+{
+#ifdef MOTOR_TABLE_VOLTAGE
+	// the same for all motors, once per loop
+	if ( motor == 0 )
+	{
+		motor_vscale = 1.0f;
+		// no scaling until the battery reading makes sense
+		if ( vbattfilt > (float) MOTOR_TABLE_VOLTAGE * 0.5f )
+			motor_vscale = (float) MOTOR_TABLE_VOLTAGE / vbattfilt;
+	}
+#endif
+
+	if (input > 1)
+		input = 1;
+	if (input < 0)
+		input = 0;
+
+	const float * table = motor_table[ MOTOR_TABLE_COUNT == 1 ? 0 : motor ];
+
+	float position = input * (MOTOR_TABLE_SIZE - 1);
+	int i = (int) position;
+	if ( i > MOTOR_TABLE_SIZE - 2 )
+		i = MOTOR_TABLE_SIZE - 2;
+
+	float output = table[i] + ( position - i ) * ( table[i + 1] - table[i] );
+
+	output *= motor_vscale;
+	if ( output > 1.0f )
+		output = 1.0f;
+
+	return output;
+}
+#endif
+
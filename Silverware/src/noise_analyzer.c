@@ -0,0 +1,190 @@
+// gyro noise analyzer
+// finds the strongest vibration peaks on each axis during flight
+// one axis at a time: NOISE_BLOCK raw samples are collected, then one
+// goertzel bin is evaluated per loop so no loop gets more than a few uS
+// results in the bayang telemetry and the debug struct
+
+#include "project.h"
+#include "config.h"
+#include "util.h"
+#include <math.h>
+
+#ifdef NOISE_ANALYZER
+
+#ifdef DEBUG
+#include "debug.h"
+extern debug_type debug;
+#endif
+
+#define NOISE_BLOCK 64
+#define NOISE_BINS ( NOISE_BLOCK / 2 )
+// ignore stick movement, bins below 3 * 15.6Hz at 1khz loop
+#define NOISE_BIN_MIN 3
+// peak hold decay per block
+#define NOISE_PEAK_DECAY 0.9f
+
+#define NOISE_SAMPLE 0
+#define NOISE_ANALYZE 1
+
+// 2 * cos( 2 * pi * k / NOISE_BLOCK ) , Q14
+static const int32_t noise_coeff[NOISE_BINS] =
+{
+	32768, 32610, 32138, 31357, 30274, 28899, 27246, 25330,
+	23170, 20788, 18205, 15447, 12540, 9512, 6393, 3212,
+	0, -3212, -6393, -9512, -12540, -15447, -18205, -20788,
+	-23170, -25330, -27246, -28899, -30274, -31357, -32138, -32610
+};
+
+int16_t noise_buffer[NOISE_BLOCK];
+int noise_count = 0;
+int noise_axis = 0;
+int noise_state = NOISE_SAMPLE;
+int noise_bin = NOISE_BIN_MIN;
+
+// strongest 2 bins of the block being analyzed
+int noise_block_bin[2];
+float noise_block_amp[2];
+
+// results, amplitude in deg/s
+float noise_peak_hz[3][2];
+float noise_peak_amp[3][2];
+
+// raw gyro, sensor units
+void noise_sample( float gyronew[3] )
+{
+	if ( noise_state != NOISE_SAMPLE ) return;
+
+	float x = gyronew[noise_axis];
+	if ( x > 32767.0f ) x = 32767.0f;
+	if ( x < -32768.0f ) x = -32768.0f;
+	noise_buffer[noise_count++] = (int16_t) x;
+
+	if ( noise_count >= NOISE_BLOCK )
+	{
+		noise_state = NOISE_ANALYZE;
+		noise_bin = NOISE_BIN_MIN;
+		noise_block_amp[0] = noise_block_amp[1] = 0;
+		noise_block_bin[0] = noise_block_bin[1] = 0;
+	}
+}
+
+// goertzel power of one bin over the block
+static float noise_goertzel( int bin )
+{
+	int64_t coeff = noise_coeff[bin];
+	int32_t s1 = 0 , s2 = 0;
+
+	for ( int i = 0 ; i < NOISE_BLOCK ; i++ )
+	{
+		int32_t s = noise_buffer[i] + (int32_t)( ( coeff * s1 ) >> 14 ) - s2;
+		s2 = s1;
+		s1 = s;
+	}
+
+	float f1 = s1;
+	float f2 = s2;
+	return f1 * f1 + f2 * f2 - f1 * f2 * coeff * ( 1.0f / 16384.0f );
+}
+
+// merge the block peaks into the held peaks of the axis
+static void noise_peaks_update( int axis )
+{
+	float * hz = noise_peak_hz[axis];
+	float * amp = noise_peak_amp[axis];
+
+	amp[0] *= NOISE_PEAK_DECAY;
+	amp[1] *= NOISE_PEAK_DECAY;
+
+	for ( int j = 0 ; j < 2 ; j++ )
+	{
+		// power to amplitude, deg/s
+		float a = sqrtf( noise_block_amp[j] ) * ( 2.0f / NOISE_BLOCK ) * 0.061035156f;
+		float f = noise_block_bin[j] * ( 1e6f / LOOPTIME / NOISE_BLOCK );
+
+		if ( a <= 0 ) continue;
+
+		// same peak as a held one
+		int same = -1;
+		for ( int i = 0 ; i < 2 ; i++ )
+			if ( fabsf( hz[i] - f ) < ( 1.5f * 1e6f / LOOPTIME / NOISE_BLOCK ) ) same = i;
+
+		if ( same >= 0 )
+		{
+			if ( a > amp[same] )
+			{
+				amp[same] = a;
+				hz[same] = f;
+			}
+		}
+		else if ( a > amp[1] )
+		{
+			amp[1] = a;
+			hz[1] = f;
+		}
+
+		// keep the strongest first
+		if ( amp[1] > amp[0] )
+		{
+			float t = amp[0]; amp[0] = amp[1]; amp[1] = t;
+			t = hz[0]; hz[0] = hz[1]; hz[1] = t;
+		}
+	}
+}
+
+// called every loop, evaluates one bin
+void noise_update( void )
+{
+	if ( noise_state != NOISE_ANALYZE ) return;
+
+	float p = noise_goertzel( noise_bin );
+
+	if ( p > noise_block_amp[0] )
+	{
+		// only a separate peak becomes the second one
+		if ( noise_bin - noise_block_bin[0] > 1 )
+		{
+			noise_block_amp[1] = noise_block_amp[0];
+			noise_block_bin[1] = noise_block_bin[0];
+		}
+		noise_block_amp[0] = p;
+		noise_block_bin[0] = noise_bin;
+	}
+	else if ( p > noise_block_amp[1] && noise_bin - noise_block_bin[0] > 1 )
+	{
+		noise_block_amp[1] = p;
+		noise_block_bin[1] = noise_bin;
+	}
+
+	noise_bin++;
+	if ( noise_bin < NOISE_BINS ) return;
+
+	noise_peaks_update( noise_axis );
+
+#ifdef DEBUG
+	debug.noise_peak_hz[noise_axis] = noise_peak_hz[noise_axis][0];
+	debug.noise_peak_amp[noise_axis] = noise_peak_amp[noise_axis][0];
+#endif
+
+	// next axis
+	noise_axis++;
+	if ( noise_axis > 2 ) noise_axis = 0;
+	noise_count = 0;
+	noise_state = NOISE_SAMPLE;
+}
+
+// telemetry bytes: strongest peak of the axis, frequency / 2 and amplitude in deg/s
+int noise_peak_byte_hz( int axis )
+{
+	int x = noise_peak_hz[axis][0] * 0.5f;
+	if ( x > 255 ) x = 255;
+	return x;
+}
+
+int noise_peak_byte_amp( int axis )
+{
+	int x = noise_peak_amp[axis][0];
+	if ( x > 255 ) x = 255;
+	return x;
+}
+
+#endif
@@ -7,48 +7,49 @@
 // the routine sends attitude, fc volts and rssi ( if available)
 
 #include "binary.h"
-#include "defines.h"
 #include "config.h"
+#include "defines.h"
 #include "rx_bayang.h" // for struct rxdebug;
+#include "drv_serial.h"
+#include "drv_time.h"
 #include <stdio.h>
 
 
 #ifdef OSD_LTM_PROTOCOL
 
-char crc;
-
-//extern int fputc(int ch, FILE * f);
-
-extern void buffer_add(int val );
-
-void Serial_print(char ch)
-{
-	buffer_add( (int) ch );
-}
+// frame rates
+#define LTM_A_PERIOD 30000
+#define LTM_S_PERIOD 332000
+#define LTM_G_PERIOD 999000
 
+// largest payload ( g frame )
+#define LTM_PAYLOAD_MAX 14
 
-void sendbyte( char val)
-{
-  crc ^= val;
-  Serial_print((char) val ); 
-}
-
-void sendint( int val)
-{
-  sendbyte( (char) (val) );
-  sendbyte( (char) (val>>8) );
-}
-
-void sendcrc()
+// put a little endian int16 in the payload
+static uint8_t * ltm_int( uint8_t * p , int val)
 {
-Serial_print((char) (crc) ); 
+  *p++ = val;
+  *p++ = val>>8;
+  return p;
 }
 
-
-void sendheader()
+// header, function, payload, crc as one serial frame
+void ltm_send( char function , const uint8_t * payload , int len )
 {
- sendbyte((char)'$');
- sendbyte((char)'T');
+ uint8_t frame[LTM_PAYLOAD_MAX + 4];
+ char crc = 0;
+	
+ frame[0] = '$';
+ frame[1] = 'T';
+ frame[2] = function;
+ for ( int i = 0 ; i < len ; i++ )
+ {
+	frame[3 + i] = payload[i];
+	crc ^= payload[i];
+ }
+ frame[3 + len] = crc;
+ 
+ serial_send( frame , len + 4 );
 }
 
 // a frame
@@ -61,13 +62,14 @@ extern float attitude[];
 
 void send_a_frame()
 {
- sendheader();
- Serial_print((char) 'A');
- crc = 0;
- sendint( attitude[0] + 0.5f );// 
- sendint( attitude[1] + 0.5f); // roll (pitch?)
- sendint(0); //heading
- sendcrc();
+ uint8_t payload[6];
+ uint8_t * p = payload;
+	
+ p = ltm_int( p , attitude[0] + 0.5f );// 
+ p = ltm_int( p , attitude[1] + 0.5f); // roll (pitch?)
+ p = ltm_int( p , 0); //heading
+	
+ ltm_send( 'A' , payload , p - payload );
 }
 
 // g frame
@@ -83,27 +85,12 @@ void send_a_frame()
 
 void send_g_frame()
 {
- sendheader();
- Serial_print( 'G');
- crc = 0;
-/*
- sendint( 0 ); // lat
- sendint( 0 ); // lat2
- sendint( 0 ); // long
- sendint( 0 ); // long2 
-	*/
- sendbyte(0); // groundspeed (m/s)
-// sendint(0);  // alti (cm)
-// sendint(0);  // alti2
+ // dummy data, only the sats byte is set
+ uint8_t payload[14] = { 0 };
 	
-// sending all above dummy data in one go for optimization
-for ( int i = 0 ; i < 6; i++)
-	{
-		 sendint(0);
-	}
+ payload[13] = B00111111; // sats
 	
- sendbyte(B00111111); // sats
- sendcrc();
+ ltm_send( 'G' , payload , 14 );
 }
 // S frame
 // 7 bytes
@@ -125,17 +112,17 @@ extern struct rxdebug rxdebug;
 
 void send_s_frame()
 {
- sendheader();
- Serial_print('S');
- crc = 0;
- sendint( (unsigned int) vbattfilt *10 + 0.5f );// vbatt mV 126 = 12.6
- sendint( 1000 ); // current mA
+ uint8_t payload[7];
+ uint8_t * p = payload;
+	
+ p = ltm_int( p , (unsigned int) vbattfilt *10 + 0.5f );// vbatt mV 126 = 12.6
+ p = ltm_int( p , 1000 ); // current mA
 	
 int rssi = rxdebug.packetpersecond;
 if (rssi > 255) rssi = 255;
 	
- sendbyte(rssi); // rssi
- sendbyte(0); // airspeed
+ *p++ = rssi; // rssi
+ *p++ = 0; // airspeed
 #define ARMED ( (rxmode!=RXMODE_BIND) )
 #define FAILSAFE failsafe
 #define MODE ( (aux[LEVELMODE])?3:4 )
@@ -147,32 +134,39 @@ if (rssi > 255) rssi = 255;
 //4 : Acro
  char status = (ARMED<<0)|(FAILSAFE<<1)|(MODE<<2);
  
- sendbyte(status); // status
+ *p++ = status; // status
  
- sendcrc();
+ ltm_send( 'S' , payload , p - payload );
 }
 
 
-int osdcount = 0;
+unsigned long ltm_a_time = 0;
+unsigned long ltm_s_time = 0;
+unsigned long ltm_g_time = 0;
 
+// called every loop, sends at most one frame
 void osdcycle()
 {
-	osdcount++;
-	if (osdcount%30 == 29)
+	unsigned long time = gettime();
+	
+	if ( time - ltm_a_time >= LTM_A_PERIOD )
 	{
+		ltm_a_time = time;
 		send_a_frame();
 		return;
 	}
 	
-	if (osdcount%999 == 1)
+	if ( time - ltm_s_time >= LTM_S_PERIOD )
 	{
-		send_g_frame();
+		ltm_s_time = time;
+		send_s_frame();
 		return;
 	}
 	
-		if (osdcount%332 == 5)
+	if ( time - ltm_g_time >= LTM_G_PERIOD )
 	{
-		send_s_frame();
+		ltm_g_time = time;
+		send_g_frame();
 		return;
 	}
 	
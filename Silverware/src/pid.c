@@ -183,7 +183,34 @@ float * current_pid_term_pointer = pidkp;
 float ierror[PIDNUMBER] = { 0 , 0 , 0};	
 float pidoutput[PIDNUMBER];
 float setpoint[PIDNUMBER];
-static float lasterror[PIDNUMBER];
+
+// everything pid() keeps between loops, besides ierror[] and pidoutput[]
+// only what the selected options use, ram is tight
+static struct
+{
+	float lasterror[3];
+#ifdef SIMPSON_RULE_INTEGRAL
+	float lasterror2[3];
+#endif
+#ifdef TRANSIENT_WINDUP_PROTECTION
+	float avgsetpoint[3];
+	int count[3];
+#endif
+#if (defined DTERM_LPF_1ST_HZ || defined DTERM_LPF_2ND_HZ)
+	float lastrate[3];
+#endif
+#ifdef ADVANCED_PID_CONTROLLER
+	float lastsetpoint[3];
+#endif
+#ifdef DTERM_LPF_1ST_HZ
+	float dlpf[3];
+#endif
+#ifdef DTERM_LPF_2ND_HZ
+	// DTERM_LPF_2ND_HZ filter
+	float last_out[3];
+	float last_out2[3];
+#endif
+} pid_state;
 float v_compensation = 1.00;
 
 extern float error[PIDNUMBER];
@@ -201,31 +228,43 @@ extern float vbattfilt;
 // multiplier for pids at 3V - for PID_VOLTAGE_COMPENSATION - default 1.33f from H101 code
 #define PID_VC_FACTOR 1.33f
 
-#ifdef SIMPSON_RULE_INTEGRAL
-static float lasterror2[PIDNUMBER];
-#endif
-
 float timefactor;
 
-// pid calculation for acro ( rate ) mode
+#ifdef ADVANCED_PID_CONTROLLER
+// active profile, picked once per loop by pid_precalc()
+static float stickAccelerator[3];
+static float stickTransitionGain[3];
+static float stickTransitionOffset[3];
+#endif
+
+// pid calculation for acro ( rate ) mode, all axes in one pass
 // input: error[x] = setpoint - gyro
 // output: pidoutput[x] = change required from motors
-float pid(int x )
+RAMFUNC void pid( void )
 { 
+    int idecay;
     if ((aux[LEVELMODE]) && (!aux[RACEMODE])){
-				if ((onground) || (in_air == 0)){
-						ierror[x] *= 0.98f;}
-		}else{
-			  if (onground) ierror[x] *= 0.98f;
-		}
+        idecay = (onground) || (in_air == 0);
+    }else{
+        idecay = onground;
+    }
+
+#ifdef ADVANCED_PID_CONTROLLER
+    extern float rxcopy[4];
+#endif
+#ifdef DTERM_LPF_2ND_HZ
+    float lpf2( float in, int num);
+#endif
+
+  for ( int x = 0 ; x < PIDNUMBER ; x++ )
+  {
+    if ( idecay ) ierror[x] *= 0.98f;
 		
 #ifdef TRANSIENT_WINDUP_PROTECTION
-    static float avgSetpoint[3];
-    static int count[3];
     extern float splpf( float in,int num );
     
-    if ( x < 2 && (count[x]++ % 2) == 0 ) {
-        avgSetpoint[x] = splpf( setpoint[x], x );
+    if ( x < 2 && (pid_state.count[x]++ % 2) == 0 ) {
+        pid_state.avgsetpoint[x] = splpf( setpoint[x], x );
     }
 #endif
 		
@@ -245,7 +284,7 @@ float pid(int x )
     #endif
  
     #ifdef TRANSIENT_WINDUP_PROTECTION
-		if ( x < 2 && fabsf( setpoint[x] - avgSetpoint[x] ) > 0.1f ) {
+		if ( x < 2 && fabsf( setpoint[x] - pid_state.avgsetpoint[x] ) > 0.1f ) {
 			iwindup = 1;
 		}
     #endif
@@ -254,20 +293,20 @@ float pid(int x )
     {
         #ifdef MIDPOINT_RULE_INTEGRAL
          // trapezoidal rule instead of rectangular
-        ierror[x] = ierror[x] + (error[x] + lasterror[x]) * 0.5f *  pidki[x] * looptime;
-        lasterror[x] = error[x];
+        ierror[x] = ierror[x] + (error[x] + pid_state.lasterror[x]) * 0.5f *  pidki[x] * looptime;
+        pid_state.lasterror[x] = error[x];
         #endif
             
         #ifdef RECTANGULAR_RULE_INTEGRAL
         ierror[x] = ierror[x] + error[x] *  pidki[x] * looptime;
-        lasterror[x] = error[x];					
+        pid_state.lasterror[x] = error[x];					
         #endif
             
         #ifdef SIMPSON_RULE_INTEGRAL
         // assuming similar time intervals
-        ierror[x] = ierror[x] + 0.166666f* (lasterror2[x] + 4*lasterror[x] + error[x]) *  pidki[x] * looptime;	
-        lasterror2[x] = lasterror[x];
-        lasterror[x] = error[x];
+        ierror[x] = ierror[x] + 0.166666f* (pid_state.lasterror2[x] + 4*pid_state.lasterror[x] + error[x]) *  pidki[x] * looptime;	
+        pid_state.lasterror2[x] = pid_state.lasterror[x];
+        pid_state.lasterror[x] = error[x];
         #endif					
     }
             
@@ -287,100 +326,42 @@ float pid(int x )
     // I term	
     pidoutput[x] += ierror[x];
 
+#if (defined DTERM_LPF_1ST_HZ || defined DTERM_LPF_2ND_HZ)
     // D term
     // skip yaw D term if not set               
     if ( pidkd[x] > 0 ){
-			
-        #if (defined DTERM_LPF_1ST_HZ && !defined ADVANCED_PID_CONTROLLER)
-        float dterm;
-        static float lastrate[3];
-        static float dlpf[3] = {0};
-
-						dterm = - (gyro[x] - lastrate[x]) * pidkd[x] * timefactor;
-						lastrate[x] = gyro[x];
-						lpf( &dlpf[x], dterm, FILTERCALC( 0.001 , 1.0f/DTERM_LPF_1ST_HZ ) );
-						pidoutput[x] += dlpf[x];                   
+        // measurement based
+        float dterm = - (gyro[x] - pid_state.lastrate[x]) * pidkd[x] * timefactor;
+        pid_state.lastrate[x] = gyro[x];
+
+        #ifdef ADVANCED_PID_CONTROLLER
+        // plus the setpoint change, weighted by stick position
+        float transitionSetpointWeight = fabsf( rxcopy[x] ) * stickTransitionGain[x] + stickTransitionOffset[x];
+        dterm += (setpoint[x] - pid_state.lastsetpoint[x]) * pidkd[x] * stickAccelerator[x] * transitionSetpointWeight * timefactor;
+        pid_state.lastsetpoint[x] = setpoint[x];
         #endif
-        
-        #if (defined DTERM_LPF_1ST_HZ && defined ADVANCED_PID_CONTROLLER)
-				extern float rxcopy[4];		
-        float dterm;		
-				float transitionSetpointWeight[3];
-				float stickAccelerator[3];
-				float stickTransition[3];
-			if (aux[PIDPROFILE]){
-				stickAccelerator[x] = stickAcceleratorProfileB[x];
-				stickTransition[x] = stickTransitionProfileB[x];
-			}else{
-				stickAccelerator[x] = stickAcceleratorProfileA[x];
-				stickTransition[x] = stickTransitionProfileA[x];
-			}				
-				if (stickAccelerator[x] < 1){
-				transitionSetpointWeight[x] = (fabs(rxcopy[x]) * stickTransition[x]) + (1- stickTransition[x]);
-				}else{
-				transitionSetpointWeight[x] = (fabs(rxcopy[x]) * (stickTransition[x] / stickAccelerator[x])) + (1- stickTransition[x]);	
-				}
-        static float lastrate[3];
-				static float lastsetpoint[3];
-        static float dlpf[3] = {0};
-        
-						dterm = ((setpoint[x] - lastsetpoint[x]) * pidkd[x] * stickAccelerator[x] * transitionSetpointWeight[x] * timefactor) - ((gyro[x] - lastrate[x]) * pidkd[x] * timefactor);
-						lastsetpoint[x] = setpoint [x];
-						lastrate[x] = gyro[x];	
-						lpf( &dlpf[x], dterm, FILTERCALC( 0.001 , 1.0f/DTERM_LPF_1ST_HZ ) );
-						pidoutput[x] += dlpf[x];                    
-        #endif	
-     		
-        #if (defined DTERM_LPF_2ND_HZ && !defined ADVANCED_PID_CONTROLLER)
-        float dterm;
-        static float lastrate[3]; 
-        float lpf2( float in, int num);
-        
-						dterm = - (gyro[x] - lastrate[x]) * pidkd[x] * timefactor;
-						lastrate[x] = gyro[x];	
-            dterm = lpf2(  dterm, x );
-            pidoutput[x] += dterm;
-				#endif   
-
-				#if (defined DTERM_LPF_2ND_HZ && defined ADVANCED_PID_CONTROLLER)
-				extern float rxcopy[4];		
-        float dterm;		
-				float transitionSetpointWeight[3];
-				float stickAccelerator[3];
-				float stickTransition[3];
-			if (aux[PIDPROFILE]){
-				stickAccelerator[x] = stickAcceleratorProfileB[x];
-				stickTransition[x] = stickTransitionProfileB[x];
-			}else{
-				stickAccelerator[x] = stickAcceleratorProfileA[x];
-				stickTransition[x] = stickTransitionProfileA[x];
-			}				
-				if (stickAccelerator[x] < 1){
-				transitionSetpointWeight[x] = (fabs(rxcopy[x]) * stickTransition[x]) + (1- stickTransition[x]);
-				}else{
-				transitionSetpointWeight[x] = (fabs(rxcopy[x]) * (stickTransition[x] / stickAccelerator[x])) + (1- stickTransition[x]);	
-				}
-        static float lastrate[3];
-				static float lastsetpoint[3];
-        float lpf2( float in, int num);
-  
-						dterm = ((setpoint[x] - lastsetpoint[x]) * pidkd[x] * stickAccelerator[x] * transitionSetpointWeight[x] * timefactor) - ((gyro[x] - lastrate[x]) * pidkd[x] * timefactor);
-						lastsetpoint[x] = setpoint [x];
-						lastrate[x] = gyro[x];	
-            dterm = lpf2(  dterm, x );
-            pidoutput[x] += dterm;		
-				#endif
-				
+
+        #ifdef DTERM_LPF_1ST_HZ
+        lpf( &pid_state.dlpf[x], dterm, FILTERCALC( 0.001 , 1.0f/DTERM_LPF_1ST_HZ ) );
+        dterm = pid_state.dlpf[x];
+        #endif
+
+        #ifdef DTERM_LPF_2ND_HZ
+        dterm = lpf2( dterm, x );
+        #endif
+
+        pidoutput[x] += dterm;
     }
+#endif
 		
     		#ifdef PID_VOLTAGE_COMPENSATION
 					pidoutput[x] *= v_compensation;
 				#endif
     limitf(  &pidoutput[x] , outlimit[x]);
-
-return pidoutput[x];		 		
+  }
 }
 
+
 // calculate change from ideal loop time
 // 0.0032f is there for legacy purposes, should be 0.001f = looptime
 // this is called in advance as an optimization because it has division
@@ -389,38 +370,53 @@ void pid_precalc()
 	timefactor = 0.0032f / looptime;
 	
 #ifdef PID_VOLTAGE_COMPENSATION
-	v_compensation = mapf ( vbattfilt , 3.00 , 4.00 , PID_VC_FACTOR , 1.00);
+	v_compensation = mapf ( vbattfilt , 3.00f , 4.00f , PID_VC_FACTOR , 1.00f);
 	if( v_compensation > PID_VC_FACTOR) v_compensation = PID_VC_FACTOR;
-	if( v_compensation < 1.00f) v_compensation = 1.00;
+	if( v_compensation < 1.00f) v_compensation = 1.00f;
 	#ifdef LEVELMODE_PID_ATTENUATION
 	if (aux[LEVELMODE]) v_compensation *= LEVELMODE_PID_ATTENUATION;
 	#endif
 #endif
+
+#ifdef ADVANCED_PID_CONTROLLER
+	// stick accelerator profile, the transition is
+	// |stick| * gain + offset ( scaled down when the accelerator is 1 or more )
+	float * accelerator = stickAcceleratorProfileA;
+	float * transition = stickTransitionProfileA;
+	if (aux[PIDPROFILE]){
+		accelerator = stickAcceleratorProfileB;
+		transition = stickTransitionProfileB;
+	}
+	for ( int i = 0 ; i < 3 ; i++ )
+	{
+		stickAccelerator[i] = accelerator[i];
+		if ( accelerator[i] < 1 ) stickTransitionGain[i] = transition[i];
+		else stickTransitionGain[i] = transition[i] / accelerator[i];
+		stickTransitionOffset[i] = 1 - transition[i];
+	}
+#endif
 }
 
 
-#ifndef DTERM_LPF_2ND_HZ 
-#define DTERM_LPF_2ND_HZ 99
-#endif
 
+#ifdef DTERM_LPF_2ND_HZ
 //the compiler calculates these
-static float two_one_minus_alpha = 2*FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) );
-static float one_minus_alpha_sqr = (FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ) )*(FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ));
-static float alpha_sqr = (1 - FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ))*(1 - FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ));
-
-static float last_out[3], last_out2[3];
+static const float two_one_minus_alpha = 2*FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) );
+static const float one_minus_alpha_sqr = (FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ) )*(FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ));
+static const float alpha_sqr = (1 - FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ))*(1 - FILTERCALC( 0.001 , (1.0f/DTERM_LPF_2ND_HZ) ));
 
 float lpf2( float in, int num)
  {
 
-  float ans = in * alpha_sqr + two_one_minus_alpha * last_out[num]
-      - one_minus_alpha_sqr * last_out2[num];   
+  float ans = in * alpha_sqr + two_one_minus_alpha * pid_state.last_out[num]
+      - one_minus_alpha_sqr * pid_state.last_out2[num];   
 
-  last_out2[num] = last_out[num];
-  last_out[num] = ans;
+  pid_state.last_out2[num] = pid_state.last_out[num];
+  pid_state.last_out[num] = ans;
   
   return ans;
  }
+#endif
 
 // below are functions used with gestures for changing pids by a percentage
 
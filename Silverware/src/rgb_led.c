@@ -1,13 +1,15 @@
 #include "config.h"
 #include "drv_time.h"
 #include "util.h"
-#include <math.h>
+#include "defines.h"
 
 extern int lowbatt;
 extern int rxmode;
 extern int failsafe;
 extern int ledcommand;
 extern char aux[];
+extern int onground;
+extern float vbattfilt;
 
 
 // normal flight rgb colour - LED switch ON
@@ -23,13 +25,17 @@ extern char aux[];
 #define RGB_FILTER_ENABLE
 #define RGB_FILTER_TIME_MICROSECONDS 50e3
 
-// runs the update once every 16 loop times ( 16 mS )
-#define DOWNSAMPLE 16
+// show the battery level on the strip while landed
+//#define RGB_BATTERY_GAUGE
 
-#define RGB_FILTER_TIME FILTERCALC( 1000*DOWNSAMPLE , RGB_FILTER_TIME_MICROSECONDS)
+// effects update rate ( 16 mS )
+#define RGB_TICK_TIME 16000
+
+// fade step in 1/256, from the equivalent lpf coefficient
+#define RGB_FILTER_K ( (int)( 256.0f * ( 1.0f - FILTERCALC( RGB_TICK_TIME , RGB_FILTER_TIME_MICROSECONDS) ) ) )
 #define RGB( r , g , b ) ( ( ((int)g&0xff)<<16)|( ((int)r&0xff)<<8)|( (int)b&0xff )) 
 
-extern	void rgb_send( int data);
+extern	void rgb_send_frame( void );
 
 
 
@@ -37,10 +43,11 @@ extern	void rgb_send( int data);
 
 // array with individual led brightnesses
 int rgb_led_value[RGB_LED_NUMBER];
-// loop count for downsampling
-int rgb_loopcount = 0;
-//rgb low pass filter variables 
-float r_filt, g_filt, b_filt;
+// effects tick counter and time
+uint32_t rgb_tick = 0;
+uint32_t rgb_lasttime = 0;
+//rgb low pass filter variables, 8.8 fixed point 
+int r_filt, g_filt, b_filt;
 
 
 // sets all leds to a brightness
@@ -53,11 +60,11 @@ int r = (rgb&0x0000FF00)>>8;
 int b = rgb & 0xff;
 
 // filter individual colors
-lpf( &r_filt, r , RGB_FILTER_TIME);
-lpf( &g_filt, g , RGB_FILTER_TIME);
-lpf( &b_filt, b , RGB_FILTER_TIME);
+r_filt += ( ( (r<<8) - r_filt ) * RGB_FILTER_K ) >> 8;
+g_filt += ( ( (g<<8) - g_filt ) * RGB_FILTER_K ) >> 8;
+b_filt += ( ( (b<<8) - b_filt ) * RGB_FILTER_K ) >> 8;
 
-	int temp = RGB( r_filt , g_filt , b_filt );
+	int temp = RGB( (r_filt + 128)>>8 , (g_filt + 128)>>8 , (b_filt + 128)>>8 );
 	
 for ( int i = 0 ; i < RGB_LED_NUMBER ; i++)
 	rgb_led_value[i] = temp;
@@ -77,7 +84,9 @@ void rgb_led_set_one( int led_number , int rgb )
 // flashes between 2 colours, duty cycle 1 - 15
 void rgb_ledflash( int color1 , int color2 , uint32_t period , int duty )
 {
-	if ( gettime() % period > (period*duty)>>4 )
+	uint32_t ticks = period / RGB_TICK_TIME;
+	if ( !ticks ) ticks = 1;
+	if ( rgb_tick % ticks > (ticks*duty)>>4 )
 	{
 		rgb_led_set_all( color1 );
 	}
@@ -92,10 +101,10 @@ void rgb_ledflash( int color1 , int color2 , uint32_t period , int duty )
 
 
 
-// speed of movement
-float KR_SPEED = 0.005f * DOWNSAMPLE;
+// speed of movement, 1/256 led per tick
+#define KR_SPEED 20
 
-float kr_position = 0;
+int kr_position = 0;
 int kr_dir = 0;
 
 // knight rider style led movement
@@ -104,7 +113,7 @@ void rgb_knight_rider( void)
 	if ( kr_dir )
 	{
 		kr_position+= KR_SPEED;
-		if ( kr_position > RGB_LED_NUMBER - 1 )
+		if ( kr_position > (RGB_LED_NUMBER - 1)<<8 )
 			kr_dir =!kr_dir;
 	}
 	else
@@ -117,12 +126,13 @@ void rgb_knight_rider( void)
 // calculate led value	
 for ( int i = 0 ; i < RGB_LED_NUMBER ; i++)
 	{
-		float led_bright = fabsf( (float) i - kr_position);	
-		if ( led_bright > 1.0f) led_bright = 1.0f;	
-		led_bright = 1.0f - led_bright;	
+		int led_bright = (i<<8) - kr_position;
+		if ( led_bright < 0 ) led_bright = -led_bright;
+		if ( led_bright > 255 ) led_bright = 255;	
+		led_bright = 255 - led_bright;	
 		
 		// set a green background as well, 32 brightness
-		rgb_led_set_one( i , RGB( (led_bright*255.0f) , (32.0f-led_bright*32.0f) , 0) );
+		rgb_led_set_one( i , RGB( led_bright , 32 - (led_bright>>3) , 0) );
 
 	}
 		
@@ -132,7 +142,9 @@ for ( int i = 0 ; i < RGB_LED_NUMBER ; i++)
 // 2 led flasher
 void rgb_ledflash_twin( int color1 , int color2 , uint32_t period )
 {
-	if ( gettime() % period > (period/2) )
+	uint32_t ticks = period / RGB_TICK_TIME;
+	if ( !ticks ) ticks = 1;
+	if ( rgb_tick % ticks > (ticks/2) )
 	{
 		for ( int i = 0 ; i < RGB_LED_NUMBER ; i++)
 			{
@@ -152,13 +164,32 @@ void rgb_ledflash_twin( int color1 , int color2 , uint32_t period )
 }
 
 
-// main function
-void rgb_led_lvc( void)
+// battery level bar, VBATTLOW to 4.2V over the whole strip
+void rgb_battery_gauge( void )
 {
-rgb_loopcount++;
-if ( rgb_loopcount > DOWNSAMPLE )
+	int mv = vbattfilt * 1000.0f;
+	int level = ( mv - (int)(VBATTLOW*1000) ) * ( RGB_LED_NUMBER<<8 ) / ( 4200 - (int)(VBATTLOW*1000) );
+	
+	for ( int i = 0 ; i < RGB_LED_NUMBER ; i++)
+	{
+		int led_bright = level - (i<<8);
+		if ( led_bright < 0 ) led_bright = 0;
+		if ( led_bright > 255 ) led_bright = 255;
+		
+		// green over half charge, orange under
+		if ( level > RGB_LED_NUMBER<<7 ) rgb_led_set_one( i , RGB( 0 , led_bright , 0 ) );
+		else rgb_led_set_one( i , RGB( led_bright , led_bright>>2 , 0 ) );
+	}
+}
+
+
+// main function, called every loop
+void rgb_led_lvc( void)
 {
-	rgb_loopcount = 0;
+if ( gettime() - rgb_lasttime < RGB_TICK_TIME ) return;
+rgb_lasttime = gettime();
+rgb_tick++;
+	
 // led flash logic	
 if ( lowbatt )
 {
@@ -183,6 +214,12 @@ else
 					rgb_ledflash ( RGB( 0 , 128 , 0 ) , RGB( 0 , 0 , 128 ) ,500000, 8);	
 					//rgb_led_set_all( RGB( 0 , 128 , 128 ) );					
 				}
+#ifdef RGB_BATTERY_GAUGE
+			else if ( onground )
+			{
+				rgb_battery_gauge();
+			}
+#endif
 			else 
 			{
 
@@ -196,17 +233,8 @@ else
 		
 	}
 
-#ifdef RGB_LED_DMA
-// send dma start signal    
-rgb_send(0);    
-#else
-// send data to leds
-for (int i = 0 ; i < RGB_LED_NUMBER ; i++)
-	{
-		rgb_send( rgb_led_value[i] );
-	}
-#endif
-}	
+// queue the frame for the dma if it changed
+rgb_send_frame();
 }
 
 #endif
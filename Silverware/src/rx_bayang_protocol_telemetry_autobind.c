@@ -35,6 +35,8 @@ THE SOFTWARE.
 #include "rx_bayang.h"
 
 #include "util.h"
+#include "stack_check.h"
+#include "irq_timing.h"
 
 
 #define RX_MODE_NORMAL RXMODE_NORMAL
@@ -337,6 +339,28 @@ void send_telemetry()
     if (lowbatt)
         txdata[3] |= (1 << 3);
 
+#ifdef STACK_CHECK
+    // free stack in words
+    txdata[2] = stack_free() / 4;
+#endif
+
+#ifdef NOISE_ANALYZER
+    // noise peak per axis, frequency / 2 , amplitude deg/s
+    extern int noise_peak_byte_hz( int axis );
+    extern int noise_peak_byte_amp( int axis );
+    for (int i = 0; i < 3; i++)
+      {
+          txdata[8 + 2 * i] = noise_peak_byte_hz(i);
+          txdata[9 + 2 * i] = noise_peak_byte_amp(i);
+      }
+#elif defined(IRQ_TIMING)
+    // interrupts off , TIM17 latency , usart handler, uS
+    for (int i = 0; i < 3; i++)
+      {
+          txdata[8 + i] = irq_timing_byte(i);
+      }
+#endif
+
     int sum = 0;
     for (int i = 0; i < 14; i++)
       {
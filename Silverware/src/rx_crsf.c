@@ -7,6 +7,7 @@
 #include "defines.h"
 #include "util.h"
 #include "drv_fmc.h"
+#include "irq_timing.h"
 
 #ifdef RX_CRSF
 
@@ -176,7 +177,15 @@ uint8_t crsfFrameCRC(void)
 // Receive ISR callback, called back from serial port
 void USART1_IRQHandler(void)	
 {
+    ISR_ENTER();
     static uint8_t crsfFramePosition = 0;
+#ifdef TIMEBASE_TIM2
+    // uS since the last byte
+    unsigned long time = gettime();
+    static unsigned long lasttime;
+    unsigned long crsfTimeInterval = time - lasttime;
+    lasttime = time;
+#else
     unsigned long  maxticks = SysTick->LOAD;	
     unsigned long ticks = SysTick->VAL;	
     unsigned long crsfTimeInterval;	
@@ -188,6 +197,7 @@ void USART1_IRQHandler(void)
         crsfTimeInterval = lastticks + ( maxticks - ticks);	
         }
 		lastticks = ticks;
+#endif
 	
 		if ( USART_GetFlagStatus(USART1 , USART_FLAG_ORE ) ){
       // overflow means something was lost 
@@ -207,6 +217,14 @@ void USART1_IRQHandler(void)
 		const uint8_t fullFrameLength = crsfFramePosition < 3 ? 5 : crsfFrame.frame.frameLength + CRSF_FRAME_LENGTH_ADDRESS + CRSF_FRAME_LENGTH_FRAMELENGTH;
     if (crsfFramePosition < fullFrameLength) {
         crsfFrame.bytes[crsfFramePosition++] = USART_ReceiveData(USART1);
+        // a corrupt length would run past the frame buffer
+        if ( crsfFramePosition == 2 && ( crsfFrame.frame.frameLength < CRSF_FRAME_LENGTH_TYPE_CRC
+            || crsfFrame.frame.frameLength > CRSF_FRAME_SIZE_MAX - CRSF_FRAME_LENGTH_ADDRESS - CRSF_FRAME_LENGTH_FRAMELENGTH ) )
+        {
+            crsfFramePosition = 0;
+            ISR_EXIT( ISR_USART1 );
+            return;
+        }
 				if (crsfFramePosition < fullFrameLength) {
 						crsfFrameDone = 0;
 				}else{
@@ -216,6 +234,8 @@ void USART1_IRQHandler(void)
             crsfFramePosition = 0;
         }
     }
+
+    ISR_EXIT( ISR_USART1 );
 }
 
 
@@ -227,7 +247,8 @@ void crsfFrameStatus(void)
 				rx_frame_pending = 1;															//flags when last time through we had a frame and this time we dont
     }else{
         crsfFrameDone = 0;
-        if (crsfFrame.frame.type == CRSF_FRAMETYPE_RC_CHANNELS_PACKED) {
+        if (crsfFrame.frame.type == CRSF_FRAMETYPE_RC_CHANNELS_PACKED
+            && crsfFrame.frame.frameLength == CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE + CRSF_FRAME_LENGTH_TYPE_CRC) {
             // CRC includes type and payload of each frame
             const uint8_t crc = crsfFrameCRC();
             if (crc != crsfFrame.frame.payload[CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE]) {
@@ -133,7 +133,10 @@ static int decodepacket( void)
 		rx[1] = -cx10scale(11) ; // elev
 		rx[3] = (cx10scale(13) + 1.0f)*0.5f ; // throttle
 		rx[2] = cx10scale(15) ; // throttle
-				
+		// no checksum, keep the throttle in range for any packet that passes the crc
+		if ( rx[3] > 1.0f ) rx[3] = 1.0f;
+		if ( rx[3] < 0.0f ) rx[3] = 0.0f;
+
 #ifndef DISABLE_EXPO
 							if (aux[LEVELMODE]){
 								if (aux[RACEMODE]){
@@ -7,6 +7,7 @@
 #include "defines.h"
 #include "util.h"
 #include "drv_fmc.h"
+#include "irq_timing.h"
 
 
 
@@ -69,8 +70,16 @@ float dsmx_scalefactor = (0.14662756f/DSM_SCALE_PERCENT);
 // Receive ISR callback
 void USART1_IRQHandler(void)
 { 
+	ISR_ENTER();
     static uint8_t spekFramePosition = 0;
 	
+#ifdef TIMEBASE_TIM2
+    // uS since the last byte
+    unsigned long time = gettime();
+    static unsigned long lasttime;
+    unsigned long spekTimeInterval = time - lasttime;
+    lasttime = time;
+#else
     unsigned long  maxticks = SysTick->LOAD;	
     unsigned long ticks = SysTick->VAL;	
     unsigned long spekTimeInterval;	
@@ -82,6 +91,7 @@ void USART1_IRQHandler(void)
         spekTimeInterval = lastticks + ( maxticks - ticks);	
         }
 		lastticks = ticks;
+#endif
 	
 		if ( USART_GetFlagStatus(USART1 , USART_FLAG_ORE ) ){
       // overflow means something was lost 
@@ -99,6 +109,8 @@ void USART1_IRQHandler(void)
        }
     }
 		spekFramePosition%=(SPEK_FRAME_SIZE);
+
+	ISR_EXIT( ISR_USART1 );
 } 
 
 
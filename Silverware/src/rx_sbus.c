@@ -7,6 +7,7 @@
 #include "drv_time.h"
 #include "defines.h"
 #include "util.h"
+#include "irq_timing.h"
 
 
 // sbus input ( pin SWCLK after calibration) 
@@ -35,7 +36,15 @@ int rx_ready = 0;
 uint8_t rx_buffer[RX_BUFF_SIZE];    //spekFrame[SPEK_FRAME_SIZE]
 uint8_t rx_start = 0;
 uint8_t rx_end = 0;
-uint16_t rx_time[RX_BUFF_SIZE];			//????
+uint16_t rx_time[RX_BUFF_SIZE];			// time since the previous byte
+
+// max time between bytes of a frame ( 120uS per byte )
+#ifdef TIMEBASE_TIM2
+#define SBUS_SYMBOL_TIME 150
+#else
+// systick ticks
+#define SBUS_SYMBOL_TIME 1024
+#endif
 
 int framestarted = -1;
 uint8_t framestart = 0;
@@ -71,8 +80,16 @@ int stat_overflow;
 
 void USART1_IRQHandler(void)
 {
+	ISR_ENTER();
     rx_buffer[rx_end] = USART_ReceiveData(USART1);
     // calculate timing since last rx
+#ifdef TIMEBASE_TIM2
+    // uS since the last byte
+    unsigned long time = gettime();
+    static unsigned long lasttime;
+    unsigned long elapsedticks = time - lasttime;
+    lasttime = time;
+#else
     unsigned long  maxticks = SysTick->LOAD;	
     unsigned long ticks = SysTick->VAL;	
     unsigned long elapsedticks;	
@@ -84,10 +101,11 @@ void USART1_IRQHandler(void)
         elapsedticks = lastticks + ( maxticks - ticks);	
         }
 
+    lastticks = ticks;
+#endif
+
     if ( elapsedticks < 65536 ) rx_time[rx_end] = elapsedticks; //
     else rx_time[rx_end] = 65535;  //ffff
-
-    lastticks = ticks;
        
     if ( USART_GetFlagStatus(USART1 , USART_FLAG_ORE ) )
     {
@@ -99,6 +117,8 @@ void USART1_IRQHandler(void)
         
     rx_end++;
     rx_end%=(RX_BUFF_SIZE);
+
+	ISR_EXIT( ISR_USART1 );
 }
 
 
@@ -192,7 +212,8 @@ else if ( framestarted == 1)
  int size = 0;
     if (rx_end > framestart ) size = rx_end - framestart;
     else size = RX_BUFF_SIZE - framestart + rx_end;
- if ( size >= 24 )
+ // start byte, 22 data bytes, flags and end byte
+ if ( size >= 25 )
     {    
     int timing_fail = 0; 
         
@@ -201,9 +222,12 @@ else if ( framestarted == 1)
       data[ i - framestart] = rx_buffer[i%(RX_BUFF_SIZE)];
       int symboltime = rx_time[i%(RX_BUFF_SIZE)];
       //stat_timing[ i - framestart] = symboltime;
-      if ( symboltime > 1024 &&  i - framestart > 0 ) timing_fail = 1;
+      if ( symboltime > SBUS_SYMBOL_TIME &&  i - framestart > 0 ) timing_fail = 1;
     }    
 
+    // end byte 0x00, or 0x04 - 0x34 for sbus2, else the start was a data byte
+    if ( data[24] != 0x00 && ( data[24] & 0x0F ) != 0x04 ) timing_fail = 1;
+
    if (!timing_fail) 
    {
        frame_received = 1;
@@ -238,8 +262,10 @@ else if ( framestarted == 1)
     
    last_byte = data[24];
 
-  
-    rx_start = rx_end;
+    // continue after the frame, or after a start byte that was a data byte
+    // ( skipping all received bytes could lock onto a 0x0F in the data )
+    if ( timing_fail ) rx_start = ( framestart + 1 ) % RX_BUFF_SIZE;
+    else rx_start = ( framestart + 25 ) % RX_BUFF_SIZE;
     framestarted = 0;
     bind_safety++;
     } // end frame complete  
@@ -40,6 +40,7 @@ THE SOFTWARE.
 #include "drv_serial.h"
 
 #include "drv_i2c.h"
+#include "drv_spi_gyro.h"
 
 
 #include <math.h>
@@ -71,37 +72,184 @@ extern debug_type debug;
 #define GYRO_ID_4 0x72
 #endif
 
+// sensor bus
+#ifdef USE_SPI_GYRO
+#define sensor_writereg( reg , data ) spi_gyro_writereg( reg , data )
+#define sensor_readreg( reg ) spi_gyro_readreg( reg )
+#define sensor_readdata( reg , data , size ) spi_gyro_readdata( reg , data , size )
+#define sensor_readfifo( data , size ) spi_gyro_readfifo( data , size )
+// mpu6000 , mpu6500 , mpu9250 , icm-20602 , icm-20608 , icm-20689
+#define SPI_GYRO_ID( id ) ( 0x68 == id || 0x70 == id || 0x71 == id || 0x12 == id || 0xAF == id || 0x98 == id )
+#else
+#define sensor_writereg( reg , data ) i2c_writereg( reg , data )
+#define sensor_readreg( reg ) i2c_readreg( reg )
+#define sensor_readdata( reg , data , size ) i2c_readdata( reg , data , size )
+// bursts from FIFO_R_W, the register address does not increment
+#define sensor_readfifo( data , size ) i2c_readdata( 116 , data , size )
+#endif
+
+
+#ifdef GYRO_FIFO
+// fifo bytes, at this it has overflowed ( 512 bytes on the mpu6500, 1024 on the mpu6050 )
+#define GYRO_FIFO_FULL 480
+
+#ifdef USE_SPI_GYRO
+// samples read per loop, the rest is read in the next loop
+#define GYRO_FIFO_MAX 16
+#ifndef GYRO_FIFO_RATE_DIV
+#define GYRO_FIFO_RATE_DIV 0
+#endif
+#else
+#define GYRO_FIFO_MAX 8
+// 4khz, 24 fifo bytes a loop, 34 with the accel and the count ( 14 without the fifo )
+#ifndef GYRO_FIFO_RATE_DIV
+#define GYRO_FIFO_RATE_DIV 1
+#endif
+#endif
+
+// bytes per fifo sample and the gyro position in it
+static int fifo_packet = 6;
+static int fifo_offset = 0;
+static int fifo_userctrl = 0x40;
+
+static void gyro_fifo_reset( void)
+{
+	// fifo off ( the i2c interface stays off on spi ), reset, fifo on again
+	// the reset does not clear a fifo that is still enabled on all parts
+	sensor_writereg( 106 , fifo_userctrl & ~0x40 );
+	sensor_writereg( 106 , ( fifo_userctrl & ~0x40 ) | 0x04 );
+	sensor_writereg( 106 , fifo_userctrl );
+#ifdef DEBUG
+	// resets that did not leave an empty fifo
+	uint8_t data[2];
+	if ( sensor_readdata( 114 , data , 2 ) && ( data[0] || data[1] ) )
+		debug.gyro_fifo_resets++;
+#endif
+}
+
+static void gyro_fifo_init( int id)
+{
+	// 8khz gyro rate with gyro lpf 0 or 7
+	sensor_writereg( 25 , GYRO_FIFO_RATE_DIV );
+	// fifo stops when full, mpu6500 family only
+	if ( 0x68 != id ) sensor_writereg( 26 , GYRO_LOW_PASS_FILTER | 0x40 );
+
+	if ( 0x12 == id )
+	{
+		// icm-20602, the temperature is written before the gyro
+		fifo_packet = 8;
+		fifo_offset = 2;
+		sensor_writereg( 35 , 0x10 );
+	}
+	else
+	{
+		sensor_writereg( 35 , 0x70 );
+#ifdef USE_SPI_GYRO
+		// keep the i2c interface off
+		fifo_userctrl |= 0x10;
+#endif
+	}
+
+	gyro_fifo_reset();
+}
+
+// average of the samples queued since the last loop
+// the average over one loop has nulls at multiples of the loop rate,
+// the noise frequencies that would alias to near 0hz
+// returns the number of samples, 0 if the fifo is empty or was reset
+static int gyro_fifo_read( float gyronew[3] )
+{
+	uint8_t data[2];
+	uint8_t buffer[ GYRO_FIFO_MAX * 8 ];
+
+	if ( !sensor_readdata( 114 , data , 2 ) ) return 0;
+	int count = ( data[0] << 8 ) + data[1];
+
+	if ( count >= GYRO_FIFO_FULL || count % fifo_packet )
+	{
+		// overflow or out of step, start again with an empty fifo
+		gyro_fifo_reset();
+		return 0;
+	}
+
+	int samples = count / fifo_packet;
+	if ( samples > GYRO_FIFO_MAX ) samples = GYRO_FIFO_MAX;
+#ifdef DEBUG
+	debug.gyro_fifo_samples = samples;
+#endif
+	if ( !samples ) return 0;
+
+	if ( !sensor_readfifo( buffer , samples * fifo_packet ) )
+	{
+		// a bus error leaves the fifo out of step
+		gyro_fifo_reset();
+		return 0;
+	}
+
+	int sum[3] = { 0 , 0 , 0 };
+	for ( int i = 0 ; i < samples ; i++ )
+	{
+		uint8_t * p = buffer + i * fifo_packet + fifo_offset;
+		// same order as the data registers
+		sum[1] += (int16_t) ((p[0] << 8) + p[1]);
+		sum[0] += (int16_t) ((p[2] << 8) + p[3]);
+		sum[2] += (int16_t) ((p[4] << 8) + p[5]);
+	}
+
+	float scale = 1.0f / samples;
+	for ( int i = 0 ; i < 3 ; i++ )
+	{
+		gyronew[i] = sum[i] * scale;
+	}
+	return samples;
+}
+#endif
+
 void sixaxis_init( void)
 {
 // gyro soft reset
 	
 	
-	i2c_writereg(  107 , 128);
+	sensor_writereg(  107 , 128);
 	 
  delay(40000);
 	
+#ifdef USE_SPI_GYRO
+	// i2c interface off ( mpu6000 / mpu6500 )
+	sensor_writereg( 106 , 0x10 );
+#endif
 
 // set pll to 1, clear sleep bit old type gyro (mpu-6050)	
-	i2c_writereg(  107 , 1);
+	sensor_writereg(  107 , 1);
 	
-	int newboard = !(0x68 == i2c_readreg(117) );
+	int id = sensor_readreg(117);
+	int newboard = !(0x68 == id );
+
+#ifdef USE_SPI_GYRO
+	// i2c interface off ( icm-20602 )
+	if ( 0x12 == id ) sensor_writereg( 112 , 0x40 );
+#endif
 
     delay(100);
 	
-	i2c_writereg(  28, B00011000);	// 16G scale
+	sensor_writereg(  28, B00011000);	// 16G scale
 
     
 // acc lpf for the new gyro type
 //       0-6 ( same as gyro)
-	if (newboard) i2c_writereg( 29, ACC_LOW_PASS_FILTER);
+	if (newboard) sensor_writereg( 29, ACC_LOW_PASS_FILTER);
 	
 // gyro scale 2000 deg (FS =3)
 
-	i2c_writereg( 27 , 24);
+	sensor_writereg( 27 , 24);
 	
 // Gyro DLPF low pass filter
 
-	i2c_writereg( 26 , GYRO_LOW_PASS_FILTER);
+	sensor_writereg( 26 , GYRO_LOW_PASS_FILTER);
+
+#ifdef GYRO_FIFO
+	gyro_fifo_init( id );
+#endif
 }
 
 
@@ -109,13 +257,17 @@ int sixaxis_check( void)
 {
 	#ifndef DISABLE_GYRO_CHECK
 	// read "who am I" register
-	int id = i2c_readreg( 117 );
+	int id = sensor_readreg( 117 );
 
 	#ifdef DEBUG
 	debug.gyroid = id;
 	#endif
 	
+	#ifdef USE_SPI_GYRO
+	return SPI_GYRO_ID( id );
+	#else
 	return (GYRO_ID_1==id||GYRO_ID_2==id||GYRO_ID_3==id||GYRO_ID_4==id );
+	#endif
 	#else
 	return 1;
 	#endif
@@ -131,16 +283,36 @@ float gyro[3];
 float accelcal[3];
 float gyrocal[3];
 
+#ifdef FAST_BOOT
+// gyrocal holds a saved bias loaded from flash
+int gyrocal_saved = 0;
+// bias keeps updating while still on the ground after a fast boot
+int gyrocal_refine = 0;
+#endif
+
+#if defined(FAST_BOOT) || defined(GYRO_BIAS_TRACKING)
+extern int onground;
+#endif
+
+#ifdef GYRO_BIAS_TRACKING
+// restarts the tracking from gyrocal
+static int bias_track_init = 0;
+#endif
+
 
-float lpffilter(float in, int num);
-float lpffilter2(float in, int num);
+void gyro_filter( float gyronew[3] );
 
 void sixaxis_read(void)
 {
-	int data[16];
+	uint8_t data[16];
 	float gyronew[3];
 	
-	i2c_readdata( 59 , data , 14 );
+#ifdef GYRO_FIFO
+	// accel and temperature, the gyro is read from the fifo
+	sensor_readdata( 59 , data , 8 );
+#else
+	sensor_readdata( 59 , data , 14 );
+#endif
 		
 #ifdef SENSOR_ROTATE_90_CW	         
         accel[0] = (int16_t) ((data[2] << 8) + data[3]);
@@ -204,11 +376,30 @@ void sixaxis_read(void)
 		accel[0] = -accel[0];	
 		}
 #endif	
+#ifdef GYRO_FIFO
+	if ( !gyro_fifo_read( gyronew ) )
+	{
+	// fifo empty or reset, one sample from the data registers
+	sensor_readdata( 67 , data + 8 , 6 );
+#endif
 //order
 	gyronew[1] = (int16_t) ((data[8] << 8) + data[9]);
 	gyronew[0] = (int16_t) ((data[10] << 8) + data[11]);
 	gyronew[2] = (int16_t) ((data[12] << 8) + data[13]);
+#ifdef GYRO_FIFO
+	}
+#endif
 
+#ifdef GYRO_BIAS_TRACKING
+gyro_bias_update( gyronew , (int16_t) ((data[6] << 8) + data[7]) );
+#elif defined(FAST_BOOT)
+if ( gyrocal_refine )
+{
+	if ( onground ) gyro_cal_refine( gyronew );
+	// stop at the first takeoff
+	else gyrocal_refine = 0;
+}
+#endif
 
 gyronew[0] = gyronew[0] - gyrocal[0];
 gyronew[1] = gyronew[1] - gyrocal[1];
@@ -267,27 +458,18 @@ gyronew[2] = gyronew[2] - gyrocal[2];
 gyronew[1] = - gyronew[1];
 gyronew[2] = - gyronew[2];
 
-	for (int i = 0; i < 3; i++)
-	  {
-		  gyronew[i] = gyronew[i] * 0.061035156f * 0.017453292f;
-#ifndef SOFT_LPF_NONE
-			
-		#if defined (GYRO_FILTER_PASS2) && defined (GYRO_FILTER_PASS1)
-			gyro[i] = lpffilter(gyronew[i], i);
-			gyro[i] = lpffilter2(gyro[i], i);
-		#endif
-			
-		#if defined (GYRO_FILTER_PASS1) && !defined(GYRO_FILTER_PASS2)
-			gyro[i] = lpffilter(gyronew[i], i);
-		#endif
-			
-		#if defined (GYRO_FILTER_PASS2) && !defined(GYRO_FILTER_PASS1)
-			gyro[i] = lpffilter2(gyronew[i], i);
-		#endif
-#else
-		  gyro[i] = gyronew[i];
+#ifdef GYRO_CAPTURE
+	// raw samples for noise analysis, sensor units
+	extern void capture_gyro( float gyronew[3] );
+	capture_gyro( gyronew );
+#endif
+
+#ifdef NOISE_ANALYZER
+	extern void noise_sample( float gyronew[3] );
+	noise_sample( gyronew );
 #endif
-	  }
+
+	gyro_filter( gyronew );
 
 
 }
@@ -295,9 +477,9 @@ gyronew[2] = - gyronew[2];
 
 void gyro_read( void)
 {
-int data[6];
+uint8_t data[6];
 	
-i2c_readdata( 67 , data , 6 );
+sensor_readdata( 67 , data , 6 );
 	
 float gyronew[3];
 	// order
@@ -369,37 +551,22 @@ gyronew[1] = - gyronew[1];
 gyronew[2] = - gyronew[2];
 	
 	
-for (int i = 0; i < 3; i++)
-	  {
-		  gyronew[i] = gyronew[i] * 0.061035156f * 0.017453292f;
-#ifndef SOFT_LPF_NONE
-			
-		#if defined (GYRO_FILTER_PASS2) && defined (GYRO_FILTER_PASS1)
-			gyro[i] = lpffilter(gyronew[i], i);
-			gyro[i] = lpffilter2(gyro[i], i);
-		#endif
-			
-		#if defined (GYRO_FILTER_PASS1) && !defined(GYRO_FILTER_PASS2)
-			gyro[i] = lpffilter(gyronew[i], i);
-		#endif
-			
-		#if defined (GYRO_FILTER_PASS2) && !defined(GYRO_FILTER_PASS1)
-			gyro[i] = lpffilter2(gyronew[i], i);
-		#endif
-#else
-		  gyro[i] = gyronew[i];
-#endif
-	  }
+gyro_filter( gyronew );
 
 }
  
 
 
+#ifdef GYRO_BIAS_TRACKING
+// the bias keeps updating on the ground so a shorter still time is enough
+#define CAL_TIME 1e6
+#else
 #define CAL_TIME 2e6
+#endif
 
 void gyro_cal(void)
 {
-int data[6];
+uint8_t data[6];
 float limit[3];	
 unsigned long time = gettime();
 unsigned long timestart = time;
@@ -422,7 +589,7 @@ while ( time - timestart < CAL_TIME  &&  time - timemax < 15e6 )
 		lastlooptime = time;
 		if ( looptime == 0 ) looptime = 1;
 
-	i2c_readdata(  67 , data , 6 );	
+	sensor_readdata(  67 , data , 6 );	
 
 			
 	gyro[1] = (int16_t) ((data[0]<<8) + data[1]);
@@ -490,11 +657,189 @@ if ( time - timestart < CAL_TIME )
 	
 }
 
+#ifdef GYRO_BIAS_TRACKING
+bias_track_init = 0;
+#endif
+
 
 	
 }
 
 
+#ifdef FAST_BOOT
+
+#define FAST_CAL_SAMPLES 50
+#define REFINE_TIME 2e6
+
+// check the saved bias against a short window of samples
+// returns 0 if there is no saved bias or the quad moves so gyro_cal() is needed
+int gyro_cal_fast(void)
+{
+uint8_t data[6];
+float gyro[3];
+float sum[3] = { 0 , 0 , 0 };
+unsigned long time = gettime();
+
+if ( !gyrocal_saved ) return 0;
+
+for ( int n = 0 ; n < FAST_CAL_SAMPLES ; n++ )
+	{
+	sensor_readdata(  67 , data , 6 );
+
+	gyro[1] = (int16_t) ((data[0]<<8) + data[1]);
+	gyro[0] = (int16_t) ((data[2]<<8) + data[3]);
+	gyro[2] = (int16_t) ((data[4]<<8) + data[5]);
+
+	for ( int i = 0 ; i < 3 ; i++)
+		{
+		// same motion limit as gyro_cal
+		if ( fabsf( gyro[i] - gyrocal[i] ) > 100 ) return 0;
+		sum[i] += gyro[i];
+		}
+
+	while ( (gettime() - time) < 1000 ) delay(10);
+	time = gettime();
+	}
+
+for ( int i = 0 ; i < 3 ; i++)
+	{
+	gyrocal[i] = sum[i] * ( 1.0f / FAST_CAL_SAMPLES );
+	}
+
+gyrocal_refine = 1;
+return 1;
+}
+
+// background bias update with raw (unrotated) gyro values, skipped while moving
+void gyro_cal_refine( float gyro[3] )
+{
+	for ( int i = 0 ; i < 3 ; i++)
+	{
+		if ( fabsf( gyro[i] - gyrocal[i] ) > 100 ) return;
+	}
+	for ( int i = 0 ; i < 3 ; i++)
+	{
+		lpf( &gyrocal[i] , gyro[i], FILTERCALC( LOOPTIME , REFINE_TIME ) );
+	}
+}
+#endif
+
+
+#ifdef GYRO_BIAS_TRACKING
+
+// gyro counts, below this on all axis the quad is still
+#define STILL_LIMIT 20
+// loops the quad has to be still before the bias updates
+#define STILL_COUNT 250
+// bias filter time while still
+#define TRACK_TIME 2e6
+// temperature filter time
+#define TEMP_TIME 1e6
+// regression time for the temperature slope
+// long enough to cover several landings at different temperatures
+#define SLOPE_TIME 120e6
+// minimum temperature variance ( deg^2 ) before the slope is used
+#define SLOPE_MIN_VAR 0.25f
+// gyro counts per degree
+#define SLOPE_LIMIT 20.0f
+
+static float temp_filt;
+static float temp_anchor;
+static float bias_anchor[3];
+static int still_count;
+
+#ifdef GYRO_BIAS_TEMP
+static float temp_mean;
+static float temp_var;
+static float bias_mean[3];
+static float bias_cov[3];
+static float bias_slope[3];
+#endif
+
+// continuous bias estimate with raw (unrotated) gyro values
+// the bias is measured while still on the ground and in flight
+// follows the temperature with the slope learned on the ground
+void gyro_bias_update( float gyro[3] , int temperature )
+{
+	// mpu temperature scale, offset does not matter here
+	float temp = temperature * ( 1.0f / 340.0f );
+
+	if ( !bias_track_init )
+	{
+		temp_filt = temp_anchor = temp;
+		for ( int i = 0 ; i < 3 ; i++)
+		{
+			bias_anchor[i] = gyrocal[i];
+		}
+#ifdef GYRO_BIAS_TEMP
+		temp_mean = temp;
+		temp_var = 0;
+		for ( int i = 0 ; i < 3 ; i++)
+		{
+			bias_mean[i] = gyrocal[i];
+			bias_cov[i] = 0;
+			bias_slope[i] = 0;
+		}
+#endif
+		still_count = 0;
+		bias_track_init = 1;
+	}
+
+	lpf( &temp_filt , temp , FILTERCALC( LOOPTIME , TEMP_TIME ) );
+
+	int still = onground;
+	for ( int i = 0 ; i < 3 ; i++)
+	{
+		if ( fabsf( gyro[i] - gyrocal[i] ) > STILL_LIMIT ) still = 0;
+	}
+
+	if ( !still )
+	{
+		still_count = 0;
+#ifdef GYRO_BIAS_TEMP
+		float dt = temp_filt - temp_anchor;
+		for ( int i = 0 ; i < 3 ; i++)
+		{
+			gyrocal[i] = bias_anchor[i] + bias_slope[i] * dt;
+		}
+#endif
+		return;
+	}
+
+	if ( still_count < STILL_COUNT )
+	{
+		still_count++;
+		return;
+	}
+
+	temp_anchor = temp_filt;
+	for ( int i = 0 ; i < 3 ; i++)
+	{
+		lpf( &bias_anchor[i] , gyro[i], FILTERCALC( LOOPTIME , TRACK_TIME ) );
+		gyrocal[i] = bias_anchor[i];
+	}
+
+#ifdef GYRO_BIAS_TEMP
+	const float coeff = FILTERCALC( LOOPTIME , SLOPE_TIME );
+	lpf( &temp_mean , temp_filt , coeff );
+	float dt = temp_filt - temp_mean;
+	lpf( &temp_var , dt * dt , coeff );
+
+	float inv_var = 0;
+	if ( temp_var > SLOPE_MIN_VAR ) inv_var = 1.0f / temp_var;
+
+	for ( int i = 0 ; i < 3 ; i++)
+	{
+		lpf( &bias_mean[i] , gyro[i] , coeff );
+		lpf( &bias_cov[i] , dt * ( gyro[i] - bias_mean[i] ) , coeff );
+		bias_slope[i] = bias_cov[i] * inv_var;
+		limitf( &bias_slope[i] , SLOPE_LIMIT );
+	}
+#endif
+}
+#endif
+
+
 void acc_cal(void)
 {
 	accelcal[2] = 2048;
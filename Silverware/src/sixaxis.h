@@ -7,6 +7,10 @@ void gyro_cal( void);
 
 void acc_cal(void);
 
+int gyro_cal_fast( void);
+void gyro_cal_refine( float gyro[3] );
+void gyro_bias_update( float gyro[3] , int temperature );
+
 
 
 
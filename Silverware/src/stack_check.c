@@ -0,0 +1,70 @@
+// stack high water mark
+// the stack area below the boot stack pointer is filled with a pattern,
+// the lowest word that no longer holds it is the deepest the stack has been
+// STACK_CHECK_WORDS words are checked per loop, from the bottom up to the mark
+// results in the debug struct and the bayang telemetry ( byte 2 )
+
+#include "project.h"
+#include "config.h"
+#include "stack_check.h"
+
+#ifdef STACK_CHECK
+
+#ifdef DEBUG
+#include "debug.h"
+extern debug_type debug;
+#endif
+
+// reserved stack, Stack_Size in the keil startup, _Min_Stack_Size in flash.ld
+#define STACK_SIZE 0x400
+#define STACK_PATTERN 0xA5A5A5A5
+#define STACK_CHECK_WORDS 32
+
+static unsigned long * stack_bottom;
+static unsigned long * stack_mark;
+static unsigned long * stack_scan;
+
+void stack_paint( void)
+{
+	// initial stack pointer, first word of the vector table
+	unsigned long top = *(unsigned long *) FLASH_BASE & ~3UL;
+	stack_bottom = (unsigned long *)( top - STACK_SIZE );
+
+	// below the current stack pointer, interrupts are not on yet
+	unsigned long * sp = (unsigned long *) __get_MSP() - 8;
+	for ( unsigned long * p = stack_bottom ; p < sp ; p++ ) *p = STACK_PATTERN;
+
+	stack_mark = sp;
+	stack_scan = stack_bottom;
+}
+
+void stack_check( void)
+{
+	for ( int i = 0 ; i < STACK_CHECK_WORDS ; i++ )
+	{
+		if ( stack_scan >= stack_mark )
+		{
+			stack_scan = stack_bottom;
+			break;
+		}
+		if ( *stack_scan != STACK_PATTERN )
+		{
+			// used deeper than the mark
+			stack_mark = stack_scan;
+			stack_scan = stack_bottom;
+			break;
+		}
+		stack_scan++;
+	}
+#ifdef DEBUG
+	debug.stack_free = stack_free();
+#endif
+}
+
+// bytes never used since boot
+int stack_free( void)
+{
+	return ( stack_mark - stack_bottom ) * 4;
+}
+
+#endif
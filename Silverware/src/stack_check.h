@@ -0,0 +1,6 @@
+// stack high water mark ( STACK_CHECK in config.h )
+// the free stack is painted at boot, a few words are checked every loop
+
+void stack_paint( void);
+void stack_check( void);
+int stack_free( void);